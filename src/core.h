@@ -105,6 +105,7 @@ extern "C" {
 #include "core/str-buf.h"
 #include "core/str-stream.h"
 #include "core/str.h"
+#include "core/mem-prof.h"
 
 #include "core/module.h"
 
@@ -21,26 +21,64 @@
 #include <lib-common/unix.h>
 #include <lib-common/thr.h>
 
-static struct {
+#ifdef HAVE_LINUX_IO_URING_H
+#include "el-io-uring.in.c"
+#endif
+
+struct el_fd_backend_t {
     int fd;
     int pending;
     int generation;
+#ifdef HAVE_LINUX_IO_URING_H
+    el_uring_t *uring;      /* set when polling with io_uring, fd is then
+                             * the one of the ring */
+#endif
+    qv_t(ev) dirty;         /* fds whose mask changed since the last wait */
+    bool     waiting;       /* the main loop waits without the big lock   */
+    bool     woken;         /* the loop was woken up since it waits        */
     struct epoll_event events[FD_SETSIZE];
-} el_epoll_g = {
-    .fd = -1,
 };
+#define el_epoll_g  (*_G.fdb)
 
 static void el_fd_at_fork(void)
 {
-    p_close(&el_epoll_g.fd);
-    el_epoll_g.generation++;
+    /* Only the forking thread survives in the child, but the epoll sets of
+     * every loop are shared with the parent and must not be used anymore.
+     */
+    spin_lock(&el_g.loops_lock);
+    dlist_for_each_entry(el_loop_t, loop, &el_g.loops, loops_link) {
+        if (loop->fdb) {
+#ifdef HAVE_LINUX_IO_URING_H
+            el_uring_delete(&loop->fdb->uring, &loop->fdb->fd);
+#endif
+            p_close(&loop->fdb->fd);
+            qv_clear(&loop->fdb->dirty);
+            loop->fdb->generation++;
+        }
+    }
+    spin_unlock(&el_g.loops_lock);
 }
 
 static void el_fd_initialize(void)
 {
+    if (unlikely(!_G.fdb)) {
+        _G.fdb = p_new(struct el_fd_backend_t, 1);
+        el_epoll_g.fd = -1;
+    }
     if (unlikely(el_epoll_g.fd == -1)) {
 #ifdef SIGPIPE
         signal(SIGPIPE, SIG_IGN);
+#endif
+#ifdef HAVE_LINUX_IO_URING_H
+        if (el_g.fd_backend == EV_FD_BACKEND_IO_URING) {
+            el_epoll_g.uring = el_uring_new(&el_epoll_g.fd);
+            if (el_epoll_g.uring) {
+                return;
+            }
+            logger_notice(&el_g.logger, "io_uring is not usable (%m), "
+                          "falling back to epoll");
+            el_g.fd_backend = EV_FD_BACKEND_EPOLL;
+        }
 #endif
         el_epoll_g.fd = epoll_create(1024);
         if (el_epoll_g.fd < 0)
@@ -49,6 +87,40 @@ static void el_fd_initialize(void)
     }
 }
 
+static void el_fd_wipe(el_loop_t *loop)
+{
+    if (loop->fdb) {
+#ifdef HAVE_LINUX_IO_URING_H
+        el_uring_delete(&loop->fdb->uring, &loop->fdb->fd);
+#endif
+        p_close(&loop->fdb->fd);
+        qv_wipe(&loop->fdb->dirty);
+        p_delete(&loop->fdb);
+    }
+}
+
+ev_fd_backend_t el_fd_set_backend(ev_fd_backend_t backend)
+{
+    ev_fd_backend_t old = el_g.fd_backend;
+
+#ifndef HAVE_LINUX_IO_URING_H
+    backend = EV_FD_BACKEND_EPOLL;
+#endif
+    el_g.fd_backend = backend;
+    return old;
+}
+
+ev_fd_backend_t el_fd_get_backend(void)
+{
+    el_fd_initialize();
+#ifdef HAVE_LINUX_IO_URING_H
+    if (el_epoll_g.uring) {
+        return EV_FD_BACKEND_IO_URING;
+    }
+#endif
+    return EV_FD_BACKEND_EPOLL;
+}
+
 el_t el_fd_register_d(int fd, bool own_fd, short events, el_fd_f *cb,
                       data_t priv)
 {
@@ -62,13 +134,96 @@ el_t el_fd_register_d(int fd, bool own_fd, short events, el_fd_f *cb,
     ev->fd.fd = fd;
     ev->fd.owned = own_fd;
     ev->fd.generation = el_epoll_g.generation;
+    ev->fd.events_armed = events;
     ev->events_wanted = events;
     ev->priority = EV_PRIORITY_NORMAL;
+#ifdef HAVE_LINUX_IO_URING_H
+    if (el_epoll_g.uring) {
+        el_uring_poll_add(el_epoll_g.uring, el_epoll_g.fd, ev);
+        return ev;
+    }
+#endif
     if (unlikely(epoll_ctl(el_epoll_g.fd, EPOLL_CTL_ADD, fd, &event)))
         e_panic(E_UNIXERR("epoll_ctl"));
     return ev;
 }
 
+static void el_fd_commit(void);
+
+/* Mask changes are only recorded, and committed at once right before the
+ * next wait: a mask that is toggled several times during an iteration (e.g.
+ * POLLOUT on a write burst) costs at most one update.
+ *
+ * Another thread holding the big lock may change a mask while the main loop
+ * waits: the change is then applied at once with epoll, and the loop is
+ * woken up with io_uring, whose ring is only fed by the loop thread.
+ */
+static void el_fd_mark_dirty(ev_t *ev)
+{
+    if (!EV_FLAG_HAS(ev, FD_DIRTY)) {
+        EV_FLAG_SET(ev, FD_DIRTY);
+        qv_append(&el_epoll_g.dirty, ev);
+    }
+    if (unlikely(el_epoll_g.waiting)) {
+#ifdef HAVE_LINUX_IO_URING_H
+        if (el_epoll_g.uring) {
+            if (!el_epoll_g.woken) {
+                el_epoll_g.woken = true;
+                el_wake_fire(_G.post_wake);
+            }
+            return;
+        }
+#endif
+        el_fd_commit();
+    }
+}
+
+static void el_fd_commit(void)
+{
+    tab_for_each_entry(ev, &el_epoll_g.dirty) {
+        uint32_t events;
+
+        /* skip the unregistered fds */
+        if (ev->type != EV_FD || !EV_FLAG_HAS(ev, FD_DIRTY)) {
+            continue;
+        }
+        EV_FLAG_RST(ev, FD_DIRTY);
+        if (unlikely(ev->fd.generation != el_epoll_g.generation)) {
+            continue;
+        }
+
+        events = ev->events_wanted;
+        if (EV_FLAG_HAS(ev, FD_EDGE)) {
+            events |= EPOLLET;
+        }
+        if (events == ev->fd.events_armed) {
+            continue;
+        }
+        ev->fd.events_armed = events;
+
+#ifdef HAVE_LINUX_IO_URING_H
+        if (el_epoll_g.uring) {
+            el_uring_poll_remove(el_epoll_g.uring, el_epoll_g.fd, ev);
+            el_uring_poll_add(el_epoll_g.uring, el_epoll_g.fd, ev);
+            continue;
+        }
+#endif
+        {
+            struct epoll_event event = {
+                .data.ptr = ev,
+                .events   = events,
+            };
+
+            if (unlikely(epoll_ctl(el_epoll_g.fd, EPOLL_CTL_MOD, ev->fd.fd,
+                                   &event)))
+            {
+                e_panic(E_UNIXERR("epoll_ctl"));
+            }
+        }
+    }
+    qv_clear(&el_epoll_g.dirty);
+}
+
 short el_fd_set_mask(ev_t *ev, short events)
 {
     short old = ev->events_wanted;
@@ -78,15 +233,25 @@ short el_fd_set_mask(ev_t *ev, short events)
                 events & POLLIN ? "IN" : "", events & POLLOUT ? "OUT" : "");
     }
     CHECK_EV_TYPE(ev, EV_FD);
-    if (old != events && likely(ev->fd.generation == el_epoll_g.generation)) {
-        struct epoll_event event = {
-            .data.ptr = ev,
-            .events   = ev->events_wanted = events,
-        };
-        if (unlikely(epoll_ctl(el_epoll_g.fd, EPOLL_CTL_MOD, ev->fd.fd,
-                               &event))) {
-            e_panic(E_UNIXERR("epoll_ctl"));
+    if (old != events) {
+        ev->events_wanted = events;
+        el_fd_mark_dirty(ev);
+    }
+    return old;
+}
+
+bool el_fd_set_edge_triggered(ev_t *ev, bool edge)
+{
+    bool old = EV_FLAG_HAS(ev, FD_EDGE);
+
+    CHECK_EV_TYPE(ev, EV_FD);
+    if (old != edge) {
+        if (edge) {
+            EV_FLAG_SET(ev, FD_EDGE);
+        } else {
+            EV_FLAG_RST(ev, FD_EDGE);
         }
+        el_fd_mark_dirty(ev);
     }
     return old;
 }
@@ -98,6 +263,13 @@ data_t el_fd_unregister(ev_t **evp)
 
         CHECK_EV_TYPE(ev, EV_FD);
         if (el_epoll_g.generation == ev->fd.generation) {
+#ifdef HAVE_LINUX_IO_URING_H
+            if (el_epoll_g.uring) {
+                /* The removal is only submitted with the next wait, the
+                 * kernel keeps a reference on the file until then. */
+                el_uring_poll_remove(el_epoll_g.uring, el_epoll_g.fd, ev);
+            } else
+#endif
             epoll_ctl(el_epoll_g.fd, EPOLL_CTL_DEL, ev->fd.fd, NULL);
         }
         if (ev->fd.owned) {
@@ -116,18 +288,44 @@ data_t el_fd_unregister(ev_t **evp)
 
 static void el_loop_fds_poll(int timeout)
 {
-    el_bl_unlock();
+    bool is_main = el_loop_is_main();
+    uint64_t start = get_clock_ns();
+
+    /* the dirty fds are shared with the threads that change them under the
+     * big lock, commit them before releasing it */
+    el_fd_commit();
     timeout = el_signal_has_pending_events() ? 0 : timeout;
-    thr_enter_blocking_syscall();
+
+    /* Only the main thread is part of the thr-job pool (and holds the big
+     * lock), other loops run in threads of their own. */
+    if (is_main) {
+        el_epoll_g.waiting = true;
+        el_bl_unlock();
+        thr_enter_blocking_syscall();
+    }
+#ifdef HAVE_LINUX_IO_URING_H
+    if (el_epoll_g.uring) {
+        el_epoll_g.pending = el_uring_wait(el_epoll_g.uring, el_epoll_g.fd,
+                                           el_epoll_g.events,
+                                           countof(el_epoll_g.events),
+                                           timeout);
+    } else
+#endif
     el_epoll_g.pending = epoll_wait(el_epoll_g.fd, el_epoll_g.events,
                                     countof(el_epoll_g.events), timeout);
-    thr_exit_blocking_syscall();
-    el_bl_lock();
+    if (is_main) {
+        thr_exit_blocking_syscall();
+        el_bl_lock();
+        el_epoll_g.waiting = false;
+        el_epoll_g.woken   = false;
+    }
     assert (el_epoll_g.pending >= 0 || ERR_RW_RETRIABLE(errno));
+    _G.stats_wait_ns += get_clock_ns() - start;
 }
 
 static bool el_fds_has_pending_events(void)
 {
+    el_fd_initialize();
     if (el_epoll_g.pending == 0) {
         el_loop_fds_poll(0);
     }
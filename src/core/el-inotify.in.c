@@ -160,6 +160,7 @@ el_t el_fs_watch_register_d(const char *path, uint32_t flags,
     ev_t *ev;
     int  wd;
 
+    ASSERT_MAIN_LOOP();
     inotify_initialize();
     wd = RETHROW_NP(inotify_add_watch(inotify_g.fd, path, flags));
     pos = qm_put(ev, &inotify_g.watches, wd, NULL, 0);
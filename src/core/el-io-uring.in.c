@@ -0,0 +1,345 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+/* io_uring based polling of the EV_FD events.
+ *
+ * Every watched file descriptor has a single one-shot IORING_OP_POLL_ADD
+ * request in flight, which is re-armed as soon as its completion is reaped:
+ * this gives the same level-triggered semantics as the epoll backend so that
+ * the dispatching code in el-epoll.in.c is shared between both. Edge
+ * triggered fds use a multishot poll request instead.
+ *
+ * Registrations, mask changes and unregistrations only queue submission
+ * entries, they are all flushed along with the wait by a single
+ * io_uring_enter() call per loop iteration.
+ *
+ * The user_data of a poll request holds the ev_t pointer in its low 48 bits
+ * and an arming sequence in its high 16 bits, so that the completions of
+ * requests that were removed or replaced in the meantime can be ignored.
+ * Internal requests (poll removals) use a user_data of 0.
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define EL_URING_SQ_ENTRIES  4096
+#define EL_URING_CQ_ENTRIES  (4 * EL_URING_SQ_ENTRIES)
+#define EL_URING_SEQ_SHIFT   48
+#define EL_URING_EV_MASK     ((UINT64_C(1) << EL_URING_SEQ_SHIFT) - 1)
+
+typedef struct el_uring_t {
+    /* submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned  sq_mask;
+    unsigned  sq_entries;
+    unsigned  sq_local_tail;
+    unsigned  to_submit;
+    struct io_uring_sqe *sqes;
+
+    /* completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned  cq_mask;
+    struct io_uring_cqe *cqes;
+
+    uint16_t  seq;
+
+    void     *sq_ring;
+    void     *cq_ring;
+    size_t    sq_ring_size;
+    size_t    cq_ring_size;
+    size_t    sqes_size;
+} el_uring_t;
+
+static int el_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int el_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                          unsigned flags, void *arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+static void el_uring_delete(el_uring_t **urp, int *fdp)
+{
+    el_uring_t *ur = *urp;
+
+    if (!ur) {
+        return;
+    }
+    if (ur->sqes) {
+        munmap(ur->sqes, ur->sqes_size);
+    }
+    if (ur->cq_ring && ur->cq_ring != ur->sq_ring) {
+        munmap(ur->cq_ring, ur->cq_ring_size);
+    }
+    if (ur->sq_ring) {
+        munmap(ur->sq_ring, ur->sq_ring_size);
+    }
+    p_close(fdp);
+    p_delete(urp);
+}
+
+/* Returns NULL with errno set when io_uring is not usable, in which case the
+ * caller falls back to epoll.
+ */
+static el_uring_t *el_uring_new(int *fdp)
+{
+    struct io_uring_params p;
+    el_uring_t *ur;
+    int fd;
+
+    p_clear(&p, 1);
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    p.cq_entries = EL_URING_CQ_ENTRIES;
+    fd = el_uring_setup(EL_URING_SQ_ENTRIES, &p);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    /* The wait timeout needs IORING_ENTER_EXT_ARG, and the completions must
+     * never be dropped since a lost poll completion is a watch that is never
+     * re-armed.
+     */
+    if (!(p.features & IORING_FEAT_EXT_ARG)
+    ||  !(p.features & IORING_FEAT_NODROP))
+    {
+        close(fd);
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    ur = p_new(el_uring_t, 1);
+    *fdp = fd;
+    fd_set_features(fd, O_CLOEXEC);
+
+    ur->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ur->cq_ring_size = p.cq_off.cqes
+                     + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ur->sq_ring_size = MAX(ur->sq_ring_size, ur->cq_ring_size);
+        ur->cq_ring_size = ur->sq_ring_size;
+    }
+
+    ur->sq_ring = mmap(NULL, ur->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ur->sq_ring == MAP_FAILED) {
+        ur->sq_ring = NULL;
+        goto error;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ur->cq_ring = ur->sq_ring;
+    } else {
+        ur->cq_ring = mmap(NULL, ur->cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd,
+                           IORING_OFF_CQ_RING);
+        if (ur->cq_ring == MAP_FAILED) {
+            ur->cq_ring = NULL;
+            goto error;
+        }
+    }
+    ur->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ur->sqes = mmap(NULL, ur->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ur->sqes == MAP_FAILED) {
+        ur->sqes = NULL;
+        goto error;
+    }
+
+    ur->sq_head    = (unsigned *)((char *)ur->sq_ring + p.sq_off.head);
+    ur->sq_tail    = (unsigned *)((char *)ur->sq_ring + p.sq_off.tail);
+    ur->sq_array   = (unsigned *)((char *)ur->sq_ring + p.sq_off.array);
+    ur->sq_mask    = *(unsigned *)((char *)ur->sq_ring + p.sq_off.ring_mask);
+    ur->sq_entries = p.sq_entries;
+    ur->sq_local_tail = *ur->sq_tail;
+
+    ur->cq_head = (unsigned *)((char *)ur->cq_ring + p.cq_off.head);
+    ur->cq_tail = (unsigned *)((char *)ur->cq_ring + p.cq_off.tail);
+    ur->cq_mask = *(unsigned *)((char *)ur->cq_ring + p.cq_off.ring_mask);
+    ur->cqes    = (struct io_uring_cqe *)((char *)ur->cq_ring
+                                          + p.cq_off.cqes);
+    return ur;
+
+  error:
+    {
+        int save_errno = errno;
+
+        el_uring_delete(&ur, fdp);
+        errno = save_errno;
+        return NULL;
+    }
+}
+
+static void el_uring_flush(el_uring_t *ur, int fd)
+{
+    while (ur->to_submit) {
+        int res = el_uring_enter(fd, ur->to_submit, 0, 0, NULL, 0);
+
+        if (res < 0) {
+            if (ERR_RW_RETRIABLE(errno)) {
+                continue;
+            }
+            e_panic(E_UNIXERR("io_uring_enter"));
+        }
+        ur->to_submit -= res;
+    }
+}
+
+static struct io_uring_sqe *el_uring_get_sqe(el_uring_t *ur, int fd)
+{
+    unsigned tail = ur->sq_local_tail;
+    unsigned idx;
+    struct io_uring_sqe *sqe;
+
+    if (unlikely(tail - __atomic_load_n(ur->sq_head, __ATOMIC_ACQUIRE)
+                 >= ur->sq_entries))
+    {
+        el_uring_flush(ur, fd);
+    }
+
+    idx = tail & ur->sq_mask;
+    sqe = &ur->sqes[idx];
+    p_clear(sqe, 1);
+    ur->sq_array[idx] = idx;
+    ur->sq_local_tail = tail + 1;
+    ur->to_submit++;
+    return sqe;
+}
+
+static void el_uring_commit(el_uring_t *ur)
+{
+    __atomic_store_n(ur->sq_tail, ur->sq_local_tail, __ATOMIC_RELEASE);
+}
+
+static void el_uring_poll_add(el_uring_t *ur, int fd, ev_t *ev)
+{
+    struct io_uring_sqe *sqe = el_uring_get_sqe(ur, fd);
+    uint32_t events = (uint16_t)ev->events_wanted;
+
+    assert (((uintptr_t)ev & ~EL_URING_EV_MASK) == 0);
+    ev->fd.seq = ++ur->seq;
+    sqe->opcode    = IORING_OP_POLL_ADD;
+    sqe->fd        = ev->fd.fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+    events = (events << 16) | (events >> 16);
+#endif
+    sqe->poll32_events = events;
+    if (EV_FLAG_HAS(ev, FD_EDGE)) {
+        /* multishot polls are edge-triggered and stay armed */
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = ((uint64_t)ev->fd.seq << EL_URING_SEQ_SHIFT)
+                   | (uintptr_t)ev;
+    el_uring_commit(ur);
+}
+
+static void el_uring_poll_remove(el_uring_t *ur, int fd, ev_t *ev)
+{
+    struct io_uring_sqe *sqe = el_uring_get_sqe(ur, fd);
+
+    sqe->opcode    = IORING_OP_POLL_REMOVE;
+    sqe->fd        = -1;
+    sqe->addr      = ((uint64_t)ev->fd.seq << EL_URING_SEQ_SHIFT)
+                   | (uintptr_t)ev;
+    sqe->user_data = 0;
+    el_uring_commit(ur);
+
+    /* Any completion of the removed request is stale from now on. */
+    ev->fd.seq = ++ur->seq;
+}
+
+/* Moves the completions of the poll requests to the events array, and
+ * re-arms the corresponding requests when needed.
+ */
+static int el_uring_reap(el_uring_t *ur, int fd,
+                         struct epoll_event *events, int max)
+{
+    unsigned head = *ur->cq_head;
+    unsigned tail = __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE);
+    int res = 0;
+
+    while (head != tail && res < max) {
+        struct io_uring_cqe *cqe = &ur->cqes[head++ & ur->cq_mask];
+        ev_t *ev = (ev_t *)(uintptr_t)(cqe->user_data & EL_URING_EV_MASK);
+        uint16_t seq = cqe->user_data >> EL_URING_SEQ_SHIFT;
+
+        if (!ev || ev->type != EV_FD || ev->fd.seq != seq) {
+            continue;
+        }
+        if (cqe->res < 0) {
+            /* A failed request is not armed anymore: retry the transient
+             * errors, and report the others as epoll would, the callback
+             * then sees POLLERR as long as the fd is watched. */
+            if (cqe->res != -ENOMEM && !ERR_RW_RETRIABLE(-cqe->res)) {
+                events[res].data.ptr = ev;
+                events[res].events   = POLLERR;
+                res++;
+            }
+        } else {
+            events[res].data.ptr = ev;
+            events[res].events   = cqe->res;
+            res++;
+        }
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            el_uring_poll_add(ur, fd, ev);
+        }
+    }
+    __atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+    return res;
+}
+
+/* Submits the pending requests, waits for at most timeout milliseconds
+ * (forever when negative) if there is no completion available yet, and
+ * reaps the completions.
+ */
+static int el_uring_wait(el_uring_t *ur, int fd,
+                         struct epoll_event *events, int max, int timeout)
+{
+    bool ready = *ur->cq_head != __atomic_load_n(ur->cq_tail,
+                                                 __ATOMIC_ACQUIRE);
+
+    if (!ready && timeout != 0) {
+        struct __kernel_timespec ts = {
+            .tv_sec  = timeout / 1000,
+            .tv_nsec = (timeout % 1000) * 1000000,
+        };
+        struct io_uring_getevents_arg arg = {
+            .ts = timeout < 0 ? 0 : (uintptr_t)&ts,
+        };
+        int res;
+
+        res = el_uring_enter(fd, ur->to_submit, 1,
+                             IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                             &arg, sizeof(arg));
+        if (res >= 0) {
+            ur->to_submit -= res;
+        } else
+        if (!ERR_RW_RETRIABLE(errno) && errno != ETIME && errno != EBUSY) {
+            e_panic(E_UNIXERR("io_uring_enter"));
+        }
+    } else {
+        el_uring_flush(ur, fd);
+    }
+    return el_uring_reap(ur, fd, events, max);
+}
@@ -69,7 +69,12 @@ typedef struct mem_fifo_pool_t {
     uint32_t    page_size;
     uint32_t    nb_pages;
 
+    /* Accounting, see mem_pools_get_stats() */
+    size_t      map_size_hwm;
+    uint64_t    allocated;
+
     char       *name;
+    char       *owner_name;
     dlist_t     pool_list;
 
 #ifdef MEM_BENCH
@@ -106,6 +111,7 @@ static mem_page_t *mem_page_new(mem_fifo_pool_t *mfp, uint32_t minsize)
     mem_tool_disallow_memory(page->area, page->size);
     mfp->nb_pages++;
     mfp->map_size   += mapsize;
+    mfp->map_size_hwm = MAX(mfp->map_size_hwm, mfp->map_size);
 
 #ifdef MEM_BENCH
     mfp->mem_bench.malloc_calls++;
@@ -205,6 +211,7 @@ static void *mfp_alloc(mem_pool_t *_mfp, size_t size, size_t alignment,
     mem_tool_disallow_memory(blk, sizeof(*blk));
 
     mfp->occupied   += size;
+    mfp->allocated  += size;
     page->used_size += size;
     page->used_blocks++;
 
@@ -368,6 +375,7 @@ static void *mfp_realloc(mem_pool_t *_mfp, void *mem, size_t oldsize,
         blk->blk_size    = size;
 
         mfp->occupied   += diff;
+        mfp->allocated  += diff;
         page->used_size += diff;
         mem_tool_freelike(mem, oldsize, 0);
         mem_tool_malloclike(mem, req_size, 0, false);
@@ -467,6 +475,7 @@ void mem_fifo_pool_delete(mem_pool_t **poolp)
 #endif
 
     p_delete(&mfp->name);
+    p_delete(&mfp->owner_name);
     mfp->alive = false;
     mem_page_delete(mfp, &mfp->freepage);
     if (mfp->current && mfp->current->used_blocks == 0) {
@@ -529,6 +538,41 @@ void mem_fifo_pools_print_stats(void)
 #endif
 }
 
+bool mem_fifo_pool_set_owner(mem_pool_t *mp, const char *owner)
+{
+    mem_fifo_pool_t *mfp = container_of(mp, mem_fifo_pool_t, funcs);
+
+    if (mp->malloc != &mfp_alloc) {
+        return false;
+    }
+
+    spin_lock(&_G.all_pools_lock);
+    p_delete(&mfp->owner_name);
+    mfp->owner_name = owner ? p_strdup(owner) : NULL;
+    spin_unlock(&_G.all_pools_lock);
+    return true;
+}
+
+void mem_fifo_pools_get_stats(mem_pool_stats_cb_f *cb, void *priv)
+{
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(mem_fifo_pool_t, mfp, &_G.all_pools, pool_list) {
+        mem_pool_stats_t st = {
+            .type         = "fifo",
+            .name         = mfp->name,
+            .owner        = mfp->owner_name,
+            .pool         = mfp,
+            .reserved     = mfp->map_size,
+            .reserved_hwm = mfp->map_size_hwm,
+            .used         = mfp->occupied,
+            .allocated    = mfp->allocated,
+        };
+
+        (*cb)(&st, priv);
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+
 /* {{{ Module (for print_state method) */
 
 static void core_mem_fifo_print_state(void)
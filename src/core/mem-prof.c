@@ -0,0 +1,435 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <dlfcn.h>
+#include <execinfo.h>
+
+#include <lib-common/core.h>
+#include <lib-common/el.h>
+#include <lib-common/log.h>
+
+/* The samples are aggregated by backtrace. The sampled blocks that can be
+ * freed individually are also kept in a map so that they can be removed
+ * from the in-use counters, and a bitmap filter avoids looking up that map
+ * for the vast majority of the frees that are not sampled.
+ *
+ * The bits of the filter cannot be cleared one by one since several blocks
+ * may share a bit, so the filter is rebuilt from the map once enough frees
+ * went through it, to keep it from saturating.
+ */
+#define MEM_PROF_DEPTH         32
+#define MEM_PROF_SKIP          3 /* sample, mem_prof_on_alloc, __mp_imalloc */
+#define MEM_PROF_FILTER_BITS   (1U << 18)
+
+typedef struct mem_prof_stack_t {
+    uint64_t alloc_objs;
+    uint64_t alloc_bytes;
+    uint64_t inuse_objs;
+    uint64_t inuse_bytes;
+
+    int      depth;
+    void    *pcs[];
+} mem_prof_stack_t;
+
+typedef struct mem_prof_live_t {
+    mem_prof_stack_t *stack;
+    uint64_t objs;
+    uint64_t bytes;
+} mem_prof_live_t;
+
+typedef struct mem_prof_frames_t {
+    uint64_t bytes;
+    int      depth;
+    void    *pcs[MEM_PROF_DEPTH];
+} mem_prof_frames_t;
+
+qm_k64_t(mem_prof_stack, mem_prof_stack_t *);
+qm_k64_t(mem_prof_live, mem_prof_live_t);
+qvector_t(mem_prof_frames, mem_prof_frames_t);
+
+bool mem_prof_enabled_g;
+
+static struct {
+    logger_t logger;
+    spinlock_t lock;
+
+    size_t period;
+    bool   initialized;
+    qm_t(mem_prof_stack) stacks;
+    qm_t(mem_prof_live)  live;
+    uint64_t filter[MEM_PROF_FILTER_BITS / 64];
+    uint64_t filter_next[MEM_PROF_FILTER_BITS / 64];
+    int      filter_hits;
+
+    el_t  signal;
+    char *signal_prefix;
+    int   signal_count;
+} core_mem_prof_g = {
+#define _G  core_mem_prof_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "core-mem-prof"),
+};
+
+static __thread struct {
+    int64_t countdown;
+
+    /* Set while the profiler runs on the thread: the allocations it does
+     * itself must not be sampled. */
+    bool    busy;
+} mem_prof_tls_g;
+
+/* {{{ Sampling */
+
+static ALWAYS_INLINE uint32_t mem_prof_filter_bit(const void *mem)
+{
+    uint64_t u = (uintptr_t)mem;
+
+    return (u * 0x9e3779b97f4a7c15ULL) >> (64 - 18);
+}
+
+static uint64_t mem_prof_stack_hash(void * const *pcs, int depth)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < depth; i++) {
+        h = (h ^ (uintptr_t)pcs[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static __attribute__((noinline))
+void mem_prof_sample(mem_pool_t *mp, const void *mem, size_t size)
+{
+    void *pcs[MEM_PROF_SKIP + MEM_PROF_DEPTH];
+    mem_prof_stack_t *stack;
+    uint64_t objs, bytes, h;
+    int depth, pos;
+
+    mem_prof_tls_g.busy = true;
+
+    depth = backtrace(pcs, countof(pcs));
+    depth = MAX(depth - MEM_PROF_SKIP, 0);
+    h = mem_prof_stack_hash(pcs + MEM_PROF_SKIP, depth);
+
+    spin_lock(&_G.lock);
+    if (!mem_prof_enabled_g) {
+        goto end;
+    }
+
+    /* The samples are taken on average every period bytes, so each one
+     * stands for period bytes worth of allocations of its size. */
+    mem_prof_tls_g.countdown = rand_range(1, 2 * _G.period);
+    if (size >= _G.period) {
+        objs = 1;
+    } else {
+        objs = _G.period / size;
+    }
+    bytes = objs * size;
+
+    pos = qm_reserve(mem_prof_stack, &_G.stacks, h, 0);
+    if (pos & QHASH_COLLISION) {
+        stack = _G.stacks.values[pos ^ QHASH_COLLISION];
+    } else {
+        stack = p_new_extra_field(mem_prof_stack_t, pcs, depth);
+        stack->depth = depth;
+        p_copy(stack->pcs, pcs + MEM_PROF_SKIP, depth);
+        _G.stacks.values[pos] = stack;
+    }
+    stack->alloc_objs  += objs;
+    stack->alloc_bytes += bytes;
+
+    if (!(mp->mem_pool & MEM_BY_FRAME)) {
+        mem_prof_live_t live = {
+            .stack = stack,
+            .objs  = objs,
+            .bytes = bytes,
+        };
+        uint32_t bit = mem_prof_filter_bit(mem);
+
+        qm_put(mem_prof_live, &_G.live, (uintptr_t)mem, live,
+               QHASH_OVERWRITE);
+        __atomic_fetch_or(&_G.filter[bit / 64], 1ULL << (bit % 64),
+                          __ATOMIC_RELAXED);
+        stack->inuse_objs  += objs;
+        stack->inuse_bytes += bytes;
+    }
+
+  end:
+    spin_unlock(&_G.lock);
+    mem_prof_tls_g.busy = false;
+}
+
+void mem_prof_on_alloc(mem_pool_t *mp, const void *mem, size_t size)
+{
+    if (mem_prof_tls_g.busy || size == 0) {
+        return;
+    }
+    mem_prof_tls_g.countdown -= size;
+    if (likely(mem_prof_tls_g.countdown > 0)) {
+        return;
+    }
+    mem_prof_sample(mp, mem, size);
+}
+
+/* Called with the lock held.
+ *
+ * The words are replaced one by one, each of them either by its old value
+ * or by a subset of it which still has the bits of all the live blocks, so
+ * the lockless readers never miss one.
+ */
+static void mem_prof_filter_rebuild(void)
+{
+    p_clear(&_G.filter_next, 1);
+    qm_for_each_key(mem_prof_live, mem, &_G.live) {
+        uint32_t bit = mem_prof_filter_bit((const void *)(uintptr_t)mem);
+
+        _G.filter_next[bit / 64] |= 1ULL << (bit % 64);
+    }
+    for (int i = 0; i < countof(_G.filter); i++) {
+        __atomic_store_n(&_G.filter[i], _G.filter_next[i], __ATOMIC_RELAXED);
+    }
+    _G.filter_hits = 0;
+}
+
+static __attribute__((noinline)) void mem_prof_forget(const void *mem)
+{
+    int pos;
+
+    mem_prof_tls_g.busy = true;
+    spin_lock(&_G.lock);
+    pos = qm_del_key(mem_prof_live, &_G.live, (uintptr_t)mem);
+    if (pos >= 0) {
+        mem_prof_live_t *live = &_G.live.values[pos];
+
+        live->stack->inuse_objs  -= live->objs;
+        live->stack->inuse_bytes -= live->bytes;
+    }
+
+    /* Rebuilding costs about as much as the frees that led to it, whether
+     * they were sampled or false positives. */
+    if (++_G.filter_hits >= MAX(qm_len(mem_prof_live, &_G.live),
+                                (int)countof(_G.filter)))
+    {
+        mem_prof_filter_rebuild();
+    }
+    spin_unlock(&_G.lock);
+    mem_prof_tls_g.busy = false;
+}
+
+void mem_prof_on_free(const void *mem)
+{
+    uint32_t bit;
+
+    if (!mem || mem == MEM_EMPTY_ALLOC || mem_prof_tls_g.busy) {
+        return;
+    }
+    bit = mem_prof_filter_bit(mem);
+    if (likely(!(__atomic_load_n(&_G.filter[bit / 64], __ATOMIC_RELAXED)
+                 & (1ULL << (bit % 64)))))
+    {
+        return;
+    }
+    mem_prof_forget(mem);
+}
+
+/* Called with the lock held. */
+static void mem_prof_clear(void)
+{
+    if (!_G.initialized) {
+        qm_init(mem_prof_stack, &_G.stacks);
+        qm_init(mem_prof_live, &_G.live);
+        _G.initialized = true;
+        return;
+    }
+    qm_deep_clear(mem_prof_stack, &_G.stacks, IGNORE, p_delete);
+    qm_clear(mem_prof_live, &_G.live);
+    p_clear(&_G.filter, 1);
+    _G.filter_hits = 0;
+}
+
+void mem_prof_start(size_t sample_period)
+{
+    sample_period = MAX(sample_period, 1U);
+    logger_notice(&_G.logger, "starting the allocation profiler, sampling "
+                  "every %zu bytes", sample_period);
+
+    mem_prof_tls_g.busy = true;
+    spin_lock(&_G.lock);
+    mem_prof_clear();
+    _G.period = sample_period;
+    mem_prof_enabled_g = true;
+    spin_unlock(&_G.lock);
+    mem_prof_tls_g.busy = false;
+}
+
+void mem_prof_stop(void)
+{
+    /* The samples are kept until the next start, but the frees are not
+     * tracked anymore: the in-use profile is frozen. */
+    spin_lock(&_G.lock);
+    mem_prof_enabled_g = false;
+    spin_unlock(&_G.lock);
+
+    logger_notice(&_G.logger, "allocation profiler stopped");
+}
+
+/* }}} */
+/* {{{ Dump */
+
+static void sb_add_mem_prof_counts(sb_t *out, uint64_t inuse_objs,
+                                   uint64_t inuse_bytes, uint64_t alloc_objs,
+                                   uint64_t alloc_bytes)
+{
+    sb_addf(out, "%ju: %ju [%ju: %ju] @", inuse_objs, inuse_bytes,
+            alloc_objs, alloc_bytes);
+}
+
+void mem_prof_dump_pprof(sb_t *out)
+{
+    uint64_t inuse_objs = 0, inuse_bytes = 0;
+    uint64_t alloc_objs = 0, alloc_bytes = 0;
+    bool busy = mem_prof_tls_g.busy;
+    SB_8k(body);
+
+    mem_prof_tls_g.busy = true;
+    spin_lock(&_G.lock);
+    if (_G.initialized) {
+        qm_for_each_value(mem_prof_stack, stack, &_G.stacks) {
+            inuse_objs  += stack->inuse_objs;
+            inuse_bytes += stack->inuse_bytes;
+            alloc_objs  += stack->alloc_objs;
+            alloc_bytes += stack->alloc_bytes;
+
+            sb_add_mem_prof_counts(&body, stack->inuse_objs,
+                                   stack->inuse_bytes, stack->alloc_objs,
+                                   stack->alloc_bytes);
+            for (int i = 0; i < stack->depth; i++) {
+                sb_addf(&body, " %p", stack->pcs[i]);
+            }
+            sb_addc(&body, '\n');
+        }
+    }
+    spin_unlock(&_G.lock);
+
+    /* The counts are already scaled, hence the sampling rate of 1. */
+    sb_adds(out, "heap profile: ");
+    sb_add_mem_prof_counts(out, inuse_objs, inuse_bytes, alloc_objs,
+                           alloc_bytes);
+    sb_adds(out, " heap_v2/1\n");
+    sb_addsb(out, &body);
+    sb_adds(out, "\nMAPPED_LIBRARIES:\n");
+    if (sb_read_file(out, "/proc/self/maps") < 0) {
+        logger_warning(&_G.logger, "cannot read the mappings: %m");
+    }
+    mem_prof_tls_g.busy = busy;
+    sb_wipe(&body);
+}
+
+/* Name a frame by its symbol when it is exported, otherwise by its offset
+ * in its object file, which can be resolved with addr2line.
+ */
+static void sb_add_mem_prof_frame(sb_t *out, const void *pc)
+{
+    Dl_info info;
+
+    if (!dladdr(pc, &info)) {
+        sb_addf(out, "%p", pc);
+    } else
+    if (info.dli_sname) {
+        sb_adds(out, info.dli_sname);
+    } else {
+        sb_addf(out, "%s+%#tx", path_filepart(info.dli_fname),
+                (const byte *)pc - (const byte *)info.dli_fbase);
+    }
+}
+
+void mem_prof_dump_collapsed(sb_t *out, bool inuse)
+{
+    t_scope;
+    bool busy = mem_prof_tls_g.busy;
+    qv_t(mem_prof_frames) frames;
+
+    /* The stacks are copied so that they are symbolized out of the lock,
+     * dladdr() being way too slow to hold the allocating threads. */
+    mem_prof_tls_g.busy = true;
+    spin_lock(&_G.lock);
+    t_qv_init(&frames, qm_len(mem_prof_stack, &_G.stacks));
+    if (_G.initialized) {
+        qm_for_each_value(mem_prof_stack, stack, &_G.stacks) {
+            uint64_t bytes = inuse ? stack->inuse_bytes : stack->alloc_bytes;
+            mem_prof_frames_t *frame;
+
+            if (!bytes) {
+                continue;
+            }
+            frame = qv_growlen(&frames, 1);
+            frame->bytes = bytes;
+            frame->depth = stack->depth;
+            p_copy(frame->pcs, stack->pcs, stack->depth);
+        }
+    }
+    spin_unlock(&_G.lock);
+
+    tab_for_each_ptr(frame, &frames) {
+        /* Collapsed stacks start from the root. */
+        for (int i = frame->depth; i-- > 0; ) {
+            sb_add_mem_prof_frame(out, frame->pcs[i]);
+            sb_addc(out, i ? ';' : ' ');
+        }
+        sb_addf(out, "%ju\n", frame->bytes);
+    }
+    mem_prof_tls_g.busy = busy;
+}
+
+static void mem_prof_on_signal(el_t ev, int signo, data_t priv)
+{
+    t_scope;
+    const char *path;
+    SB_8k(sb);
+
+    path = t_fmt("%s.%d.%d.heap", _G.signal_prefix, getpid(),
+                 _G.signal_count);
+    mem_prof_dump_pprof(&sb);
+    if (sb_write_file(&sb, path) < 0) {
+        logger_error(&_G.logger, "cannot write `%s`: %m", path);
+    }
+
+    sb_reset(&sb);
+    path = t_fmt("%s.%d.%d.collapsed", _G.signal_prefix, getpid(),
+                 _G.signal_count);
+    mem_prof_dump_collapsed(&sb, true);
+    if (sb_write_file(&sb, path) < 0) {
+        logger_error(&_G.logger, "cannot write `%s`: %m", path);
+    }
+
+    logger_notice(&_G.logger, "allocation profile #%d dumped",
+                  _G.signal_count);
+    _G.signal_count++;
+    sb_wipe(&sb);
+}
+
+void mem_prof_dump_on_signal(int signo, const char *prefix)
+{
+    el_unregister(&_G.signal);
+    p_delete(&_G.signal_prefix);
+
+    _G.signal_prefix = p_strdup(prefix);
+    _G.signal = el_signal_register(signo, &mem_prof_on_signal, NULL);
+    el_unref(_G.signal);
+}
+
+/* }}} */
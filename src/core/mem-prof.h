@@ -0,0 +1,91 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#ifndef IS_LIB_COMMON_CORE_MEM_PROF_H
+#define IS_LIB_COMMON_CORE_MEM_PROF_H
+
+#include "mem.h"
+#include "str-buf.h"
+
+/* Sampling allocation profiler {{{ */
+
+/** Sampling allocation profiler.
+ *
+ * When started, the profiler samples about one allocation every
+ * \p sample_period bytes allocated through any memory pool (libc, fifo,
+ * ring, stack, slab, ...), and records its size and backtrace. Each sample
+ * stands for the sample_period bytes allocated since the previous one.
+ *
+ * The samples of the pools that release their memory by frames (stack and
+ * ring pools) are only accounted as allocations, the other ones are
+ * accounted as in use until they are freed. Reallocations are accounted as
+ * new allocations.
+ *
+ * The profiles can be dumped in the legacy heap format of pprof, or as
+ * collapsed stacks usable by flamegraph.pl, on demand, on a signal (see
+ * mem_prof_dump_on_signal()) or on the /debug/pprof/heap endpoint of the
+ * prometheus HTTP server when it is exposed (see
+ * prom_http_expose_mem_prof()).
+ */
+
+extern bool mem_prof_enabled_g;
+
+/** Start sampling, after discarding the previous samples.
+ *
+ * \param[in] sample_period  average number of bytes between two samples.
+ */
+void mem_prof_start(size_t sample_period);
+
+/** Stop sampling.
+ *
+ * The samples are kept until the next start, but as the frees are not
+ * tracked anymore, the in-use profile is frozen.
+ */
+void mem_prof_stop(void);
+
+/* Called by the generic allocator functions when the profiler is enabled.
+ */
+void mem_prof_on_alloc(mem_pool_t * nonnull mp, const void * nullable mem,
+                       size_t size);
+void mem_prof_on_free(const void * nullable mem);
+
+/** Dump the profile in the legacy heap format of pprof.
+ *
+ * The output is followed by the mappings of the process, so that pprof can
+ * symbolize it: `pprof --text <binary> <file>`.
+ */
+void mem_prof_dump_pprof(sb_t * nonnull out);
+
+/** Dump the profile as collapsed stacks, one line per stack.
+ *
+ * \param[in] inuse  dump the bytes still in use instead of the allocated
+ *                   ones.
+ */
+void mem_prof_dump_collapsed(sb_t * nonnull out, bool inuse);
+
+/** Dump the profile to files when the process receives a signal.
+ *
+ * On each \p signo, the profile is dumped in pprof format to
+ * "<prefix>.<pid>.<n>.heap" and as collapsed in-use stacks to
+ * "<prefix>.<pid>.<n>.collapsed". The handler is run from the event loop.
+ */
+void mem_prof_dump_on_signal(int signo, const char * nonnull prefix);
+
+/* }}} */
+
+#endif
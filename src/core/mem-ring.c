@@ -46,6 +46,8 @@ static struct {
 
     dlist_t all_pools;
     spinlock_t all_pools_lock;
+
+    int mt_stripes;
 } core_mem_ring_g = {
 #define _G  core_mem_ring_g
     .logger = LOGGER_INIT_INHERITS(NULL, "core-mem-ring"),
@@ -54,6 +56,17 @@ static struct {
 
 typedef struct ring_pool_t ring_pool_t;
 
+/* Counters of the multi-producer pools, see rp_mt_fold_counters(). */
+#define RING_MT_STRIPES  16
+
+typedef struct ring_mt_counters_t {
+    size_t       alloc_sz;
+    uint32_t     alloc_nb;
+    uint64_t     allocated;
+} __attribute__((aligned(CACHE_LINE_SIZE))) ring_mt_counters_t;
+
+static __thread int ring_mt_stripe_g = -1;
+
 typedef struct ring_blk_t {
     void        *start;
     size_t       size;
@@ -88,10 +101,18 @@ struct ring_pool_t {
     uint32_t     nb_frames_release;
 
     bool         alive : 1;
+    bool         mt    : 1;
 
     mem_pool_t   funcs;
+    ring_mt_counters_t *mt_counters;
+
+    /* Accounting, see mem_pools_get_stats(): unlike alloc_sz, allocated
+     * is never halved. */
+    size_t       ringsize_hwm;
+    uint64_t     allocated;
 
     char        *name;
+    char        *owner_name;
     dlist_t      pool_list;
 };
 
@@ -146,6 +167,7 @@ static ring_blk_t *blk_create(ring_pool_t *rp, size_t size_hint)
     blk->start    = blk->area;
     blk->size     = blksize - sizeof(*blk);
     rp->ringsize += blk->size;
+    rp->ringsize_hwm = MAX(rp->ringsize_hwm, rp->ringsize);
     if (likely(rp->cblk)) {
         dlist_add_after(&rp->cblk->blist, &blk->blist);
     } else {
@@ -227,6 +249,7 @@ static void *rp_reserve(ring_pool_t *rp, size_t size, ring_blk_t **blkp)
     }
     rp->alloc_sz += size;
     rp->alloc_nb += 1;
+    rp->allocated += size;
     return res;
 }
 
@@ -294,6 +317,7 @@ static void *rp_realloc(mem_pool_t *_rp, void *mem, size_t oldsize,
     {
         rp->pos = (byte *)rp->last + size;
         rp->alloc_sz  += size - oldsize;
+        rp->allocated += size - oldsize;
         mem_tool_allow_memory(mem, size, true);
         res = mem;
     } else {
@@ -317,6 +341,213 @@ static mem_pool_t const pool_funcs = {
     .mem_pool = MEM_OTHER | MEM_BY_FRAME,
 };
 
+/* {{{ Multi-producer pools */
+
+/* In the multi-producer pools, the allocations that fit in the current block
+ * only move rp->pos forward with a compare-and-swap, the spinlock is only
+ * taken to switch to the next block.
+ *
+ * The block switch publishes rp->cblk before rp->pos, and the allocating
+ * threads load rp->pos before rp->cblk: a reservation is only attempted when
+ * the position belongs to the loaded block, so that it can never overflow
+ * the block it lies in, even when it races with a block switch.
+ *
+ * rp->last is not maintained: a reallocation extends the memory in place
+ * only if it is still at the head of the current block, which is checked by
+ * the compare-and-swap on rp->pos itself.
+ *
+ * The allocating threads do not update the counters of the pool either, but
+ * the stripe of rp->mt_counters they are bound to, which are only folded
+ * into the pool under the lock: on block switches, when the mean size of
+ * the allocations matters, and when the statistics are collected.
+ */
+
+static ring_mt_counters_t *rp_mt_counters(ring_pool_t *rp)
+{
+    if (unlikely(ring_mt_stripe_g < 0)) {
+        ring_mt_stripe_g = __atomic_fetch_add(&_G.mt_stripes, 1,
+                                              __ATOMIC_RELAXED)
+                         % RING_MT_STRIPES;
+    }
+    return &rp->mt_counters[ring_mt_stripe_g];
+}
+
+/* Called with the lock held. */
+static void rp_mt_fold_counters(ring_pool_t *rp)
+{
+    if (!rp->mt) {
+        return;
+    }
+    for (int i = 0; i < RING_MT_STRIPES; i++) {
+        ring_mt_counters_t *c = &rp->mt_counters[i];
+        size_t alloc_sz = __atomic_exchange_n(&c->alloc_sz, 0,
+                                              __ATOMIC_RELAXED);
+        uint32_t alloc_nb = __atomic_exchange_n(&c->alloc_nb, 0,
+                                                __ATOMIC_RELAXED);
+
+        /* Like in rp_reserve(), avoid the overflow of the counters. */
+        if (unlikely(rp->alloc_sz + alloc_sz < rp->alloc_sz)
+        ||  unlikely(rp->alloc_nb + alloc_nb < rp->alloc_nb))
+        {
+            rp->alloc_sz /= 2;
+            rp->alloc_nb = rp->alloc_nb / 2 ?: 1;
+        }
+        rp->alloc_sz  += alloc_sz;
+        rp->alloc_nb  += alloc_nb;
+        rp->allocated += __atomic_exchange_n(&c->allocated, 0,
+                                             __ATOMIC_RELAXED);
+    }
+}
+
+static void *rp_reserve_mt(ring_pool_t *rp, size_t size, ring_blk_t **blkp)
+{
+    ring_mt_counters_t *counters;
+    byte *res;
+
+    for (;;) {
+        void *pos = __atomic_load_n(&rp->pos, __ATOMIC_ACQUIRE);
+        ring_blk_t *blk = __atomic_load_n(&rp->cblk, __ATOMIC_ACQUIRE);
+
+        /* See rp_reserve(). */
+        assert (pos);
+
+        res = align_for(pos, size);
+        if (likely(blk_contains(blk, pos) && res + size <= blk_end(blk))) {
+            if (__atomic_compare_exchange_n(&rp->pos, &pos, res + size, true,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_RELAXED))
+            {
+                *blkp = blk;
+                break;
+            }
+            continue;
+        }
+
+        spin_lock(&rp->lock);
+        pos = __atomic_load_n(&rp->pos, __ATOMIC_RELAXED);
+        blk = rp->cblk;
+        if (blk_contains(blk, pos) && align_for(pos, size) + size
+                                      <= blk_end(blk))
+        {
+            /* Another thread already switched to a new block. */
+            spin_unlock(&rp->lock);
+            continue;
+        }
+        rp_mt_fold_counters(rp);
+        blk = frame_get_next_blk(rp, size);
+        res = blk->area;
+        __atomic_store_n(&rp->cblk, blk, __ATOMIC_RELEASE);
+        __atomic_store_n(&rp->pos, res + size, __ATOMIC_RELEASE);
+        spin_unlock(&rp->lock);
+        *blkp = blk;
+        break;
+    }
+
+    mem_tool_allow_memory(res, size, false);
+    counters = rp_mt_counters(rp);
+    __atomic_fetch_add(&counters->alloc_sz, size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->alloc_nb, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->allocated, size, __ATOMIC_RELAXED);
+    return res;
+}
+
+__flatten
+static void *rp_alloc_mt(mem_pool_t *_rp, size_t size, size_t alignment,
+                         mem_flags_t flags)
+{
+    ring_pool_t *rp = container_of(_rp, ring_pool_t, funcs);
+    ring_blk_t *blk;
+    byte *res;
+
+    if (unlikely(alignment > 16)) {
+        e_panic("mem_pool_ring does not support alignments greater than 16");
+    }
+
+    if (unlikely((size == 0))) {
+        return MEM_EMPTY_ALLOC;
+    }
+
+    res = rp_reserve_mt(rp, size, &blk);
+
+    if (!(flags & MEM_RAW)) {
+        memset(res, 0, size);
+    }
+
+    return res;
+}
+
+static void *rp_realloc_mt(mem_pool_t *_rp, void *mem, size_t oldsize,
+                           size_t size, size_t alignment, mem_flags_t flags)
+{
+    ring_pool_t *rp = container_of(_rp, ring_pool_t, funcs);
+    void *end = (byte *)mem + oldsize;
+    byte *res;
+
+    if (unlikely(alignment > 16)) {
+        e_panic("mem_pool_ring does not support alignments greater than 16");
+    }
+
+    if (unlikely(oldsize == MEM_UNKNOWN)) {
+        e_panic("ring pools do not support reallocs with unknown old size");
+    }
+
+    if (unlikely(mem == MEM_EMPTY_ALLOC)) {
+        mem = NULL;
+    }
+
+    if (oldsize >= size) {
+        if (mem) {
+            /* Give the tail back if nothing was allocated after it. */
+            __atomic_compare_exchange_n(&rp->pos, &end, (byte *)mem + size,
+                                        false, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED);
+        }
+        mem_tool_disallow_memory((byte *)mem + size, oldsize - size);
+        return size ? mem : MEM_EMPTY_ALLOC;
+    }
+
+    if (mem != NULL && is_aligned_to(mem, align_boundary(size))) {
+        ring_blk_t *blk = __atomic_load_n(&rp->cblk, __ATOMIC_ACQUIRE);
+
+        if (blk_contains(blk, mem) && (byte *)mem + size <= blk_end(blk)
+        &&  __atomic_compare_exchange_n(&rp->pos, &end, (byte *)mem + size,
+                                        false, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED))
+        {
+            ring_mt_counters_t *counters = rp_mt_counters(rp);
+
+            __atomic_fetch_add(&counters->alloc_sz, size - oldsize,
+                               __ATOMIC_RELAXED);
+            __atomic_fetch_add(&counters->allocated, size - oldsize,
+                               __ATOMIC_RELAXED);
+            mem_tool_allow_memory(mem, size, true);
+            res = mem;
+            goto done;
+        }
+    }
+
+    res = rp_alloc_mt(_rp, size, alignment, flags | MEM_RAW);
+    if (mem != NULL) {
+        memcpy(res, mem, oldsize);
+        mem_tool_allow_memory(mem, oldsize, false);
+    }
+
+  done:
+    if (!(flags & MEM_RAW)) {
+        memset(res + oldsize, 0, size - oldsize);
+    }
+    return res;
+}
+
+static mem_pool_t const pool_funcs_mt = {
+    .malloc  = &rp_alloc_mt,
+    .realloc = &rp_realloc_mt,
+    .free    = &rp_free,
+    .mem_pool = MEM_OTHER | MEM_BY_FRAME,
+};
+
+/* }}} */
+
 #ifndef NDEBUG
 static void
 mem_ring_protect(const ring_pool_t *rp, const ring_blk_t *blk,
@@ -419,6 +650,17 @@ mem_pool_t *mem_ring_new(const char *name, int initialsize)
     return &rp->funcs;
 }
 
+mem_pool_t *mem_ring_new_mt(const char *name, int initialsize)
+{
+    mem_pool_t *mp = mem_ring_new(name, initialsize);
+    ring_pool_t *rp = container_of(mp, ring_pool_t, funcs);
+
+    rp->funcs = pool_funcs_mt;
+    rp->mt    = true;
+    rp->mt_counters = p_new(ring_mt_counters_t, RING_MT_STRIPES);
+    return mp;
+}
+
 static void __mem_ring_reset(ring_pool_t *rp);
 
 void mem_ring_delete(mem_pool_t **rpp)
@@ -447,6 +689,8 @@ void mem_ring_delete(mem_pool_t **rpp)
             return;
         }
 
+        /* The statistics take the locks in the other order. */
+        spin_unlock(&rp->lock);
         spin_lock(&_G.all_pools_lock);
         dlist_remove(&rp->pool_list);
         spin_unlock(&_G.all_pools_lock);
@@ -456,6 +700,8 @@ void mem_ring_delete(mem_pool_t **rpp)
         }
         blk_destroy(rp, rp->cblk);
         p_delete(&rp->name);
+        p_delete(&rp->owner_name);
+        p_delete(&rp->mt_counters);
         p_delete(&rp);
         *rpp = NULL;
     }
@@ -493,7 +739,13 @@ const void *mem_ring_seal(mem_pool_t *_rp)
     ring_blk_t *blk;
 
     /* Makes a new frame */
-    frame = rp_reserve(rp, sizeof(frame_t), &blk);
+    if (rp->mt) {
+        frame = rp_reserve_mt(rp, sizeof(frame_t), &blk);
+    } else {
+        spin_lock(&rp->lock);
+        frame = rp_reserve(rp, sizeof(frame_t), &blk);
+        spin_unlock(&rp->lock);
+    }
     ring_setup_frame(rp, blk, frame);
 
     return last;
@@ -513,6 +765,7 @@ static void __mem_ring_reset(ring_pool_t *rp)
         return;
     }
 
+    rp_mt_fold_counters(rp);
     saved_blk  = NULL;
     saved_size = RESET_MIN * rp_alloc_mean(rp);
     max_size   = RESET_MAX * rp_alloc_mean(rp);
@@ -775,6 +1028,67 @@ size_t mem_ring_memory_footprint(const mem_pool_t *_rp)
     return sizeof(*rp) + rp->ringsize;
 }
 
+bool mem_ring_set_owner(mem_pool_t *_rp, const char *owner)
+{
+    ring_pool_t *rp = container_of(_rp, ring_pool_t, funcs);
+
+    if (_rp->malloc != &rp_alloc && _rp->malloc != &rp_alloc_mt) {
+        return false;
+    }
+
+    spin_lock(&_G.all_pools_lock);
+    p_delete(&rp->owner_name);
+    rp->owner_name = owner ? p_strdup(owner) : NULL;
+    spin_unlock(&_G.all_pools_lock);
+    return true;
+}
+
+/* Bytes from the first frame to the current position, including the
+ * released frames that are not reclaimed yet. Needs the lock of the pool.
+ */
+static size_t rp_used(ring_pool_t *rp)
+{
+    frame_t *start = dlist_first_entry(&rp->fhead, frame_t, flist);
+    const byte *end = __atomic_load_n(&rp->pos, __ATOMIC_RELAXED);
+    const byte *from = (const byte *)start;
+    ring_blk_t *blk = start->blk;
+    size_t used = 0;
+
+    if (!end) {
+        end = (const byte *)&rp->ring[1];
+    }
+    while (!blk_contains(blk, end)) {
+        used += blk_end(blk) - from;
+        blk   = dlist_next_entry(blk, blist);
+        from  = blk->area;
+    }
+    return used + (end - from);
+}
+
+void mem_ring_pools_get_stats(mem_pool_stats_cb_f *cb, void *priv)
+{
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(ring_pool_t, rp, &_G.all_pools, pool_list) {
+        mem_pool_stats_t st = {
+            .type         = "ring",
+            .name         = rp->name,
+            .owner        = rp->owner_name,
+            .pool         = rp,
+        };
+
+        spin_lock(&rp->lock);
+        rp_mt_fold_counters(rp);
+        st.reserved     = rp->ringsize;
+        st.reserved_hwm = rp->ringsize_hwm;
+        st.used         = rp_used(rp);
+        st.allocated    = rp->allocated;
+        spin_unlock(&rp->lock);
+
+        (*cb)(&st, priv);
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+
 /* }}} */
 /* {{{ Module (for print_state method) */
 
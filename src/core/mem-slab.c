@@ -0,0 +1,799 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/core.h>
+#include <lib-common/log.h>
+#include <lib-common/str-buf-pp.h>
+#include <lib-common/thr.h>
+
+/* The memory is cut in slabs of SLAB_SIZE bytes, aligned on SLAB_SIZE so
+ * that the slab of any block is found by masking its address. Each slab
+ * serves a single size class.
+ *
+ * Each thread owns a cache per pool with a magazine of free blocks per
+ * size class, so that most allocations and deallocations are done without
+ * any synchronization. Empty magazines are refilled from the depot of the
+ * pool, and full ones are half flushed to it: this is how blocks freed by
+ * another thread than the one that allocated them go back in circulation.
+ *
+ * The allocations larger than SLAB_MAX_SIZE get a slab of their own,
+ * directly allocated with the libc with its normal alignment: the header
+ * of such a slab immediately precedes the block. The slabs of the size
+ * classes are registered in a two-level bitmap indexed by their address,
+ * that tells which of the two cases applies to a block.
+ */
+#define SLAB_SIZE          (64 << 10)
+#define SLAB_MAX_SIZE      4096
+#define SLAB_NB_CLASSES    28
+#define SLAB_LARGE         UINT16_MAX
+#define SLAB_MAG_SIZE      32
+#define SLAB_MAP_BITS      16
+
+typedef struct mem_slab_pool_t mem_slab_pool_t;
+
+typedef struct mem_slab_t {
+    mem_slab_pool_t *pool;
+    uint16_t         klass;
+    size_t           size;      /* size of the area for the large slabs */
+    dlist_t          slab_list;
+
+    byte __attribute__((aligned(CACHE_LINE_SIZE))) area[];
+} mem_slab_t;
+
+typedef struct mem_slab_mag_t {
+    uint32_t count;
+
+    /* Updated by the owner thread only, read without synchronization for
+     * the statistics. */
+    uint64_t allocs;
+    uint64_t frees;
+
+    void    *blocks[SLAB_MAG_SIZE];
+} mem_slab_mag_t;
+
+typedef struct mem_slab_tcache_t {
+    mem_slab_pool_t          *pool;
+    struct mem_slab_tcache_t *next;       /* in the caches of the thread */
+    dlist_t                   tcache_list; /* in the caches of the pool  */
+    atomic_bool               dead;       /* the pool was deleted        */
+
+    mem_slab_mag_t mags[SLAB_NB_CLASSES];
+} mem_slab_tcache_t;
+
+typedef struct mem_slab_class_t {
+    void   *freelist;           /* linked by their first word */
+    byte   *bump;
+    byte   *bump_end;
+
+    /* Counters of the caches of the threads that exited. */
+    uint64_t allocs;
+    uint64_t frees;
+} mem_slab_class_t;
+
+struct mem_slab_pool_t {
+    mem_pool_t funcs;
+    spinlock_t lock;
+
+    mem_slab_class_t classes[SLAB_NB_CLASSES];
+    dlist_t          slabs;
+    dlist_t          tcaches;
+    uint32_t         nb_slabs;
+    uint32_t         nb_large;
+    size_t           map_size;
+    size_t           large_size;
+    uint64_t         refills;
+    uint64_t         flushes;
+
+    /* Accounting, see mem_pools_get_stats() */
+    size_t           map_size_hwm;
+    uint64_t         large_allocated;
+
+    char    *name;
+    char    *owner_name;
+    dlist_t  pool_list;
+};
+
+static struct {
+    logger_t logger;
+
+    /* Protects the list of pools, and the lifetime of the pools against
+     * the exit of the threads that have a cache in them. */
+    dlist_t all_pools;
+    spinlock_t all_pools_lock;
+
+    /* Bitmap of the slabs of the size classes, by address / SLAB_SIZE. The
+     * leaves of 2^SLAB_MAP_BITS bits are allocated on demand and never
+     * freed. */
+    _Atomic uint64_t * _Atomic slab_map[1 << SLAB_MAP_BITS];
+} core_mem_slab_g = {
+#define _G  core_mem_slab_g
+    .logger = LOGGER_INIT_INHERITS(NULL, "core-mem-slab"),
+    .all_pools = DLIST_INIT(_G.all_pools),
+};
+
+static __thread struct {
+    mem_slab_tcache_t *caches;
+    mem_slab_tcache_t *last;
+} mem_slab_tls_g;
+
+/* {{{ Size classes */
+
+/* 16 to 128 by steps of 16, then 4 classes per power of 2 up to 4096. */
+static uint16_t const mem_slab_class_sizes_g[SLAB_NB_CLASSES] = {
+    16,   32,   48,   64,   80,   96,   112,  128,
+    160,  192,  224,  256,  320,  384,  448,  512,
+    640,  768,  896,  1024, 1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096,
+};
+
+static ALWAYS_INLINE unsigned mem_slab_class(size_t size)
+{
+    size_t s = size - 1;
+    size_t b;
+
+    if (size <= 128) {
+        return s / 16;
+    }
+    b = bsrsz(s);
+    return 8 + (b - 7) * 4 + ((s >> (b - 2)) & 3);
+}
+
+static _Atomic uint64_t *mem_slab_map_leaf(uintptr_t n)
+{
+    _Atomic uint64_t * _Atomic *slot = &_G.slab_map[n >> SLAB_MAP_BITS];
+    _Atomic uint64_t *leaf = atomic_load_explicit(slot, memory_order_acquire);
+    _Atomic uint64_t *new_leaf;
+
+    assert ((n >> (2 * SLAB_MAP_BITS)) == 0);
+    if (likely(leaf)) {
+        return leaf;
+    }
+    new_leaf = p_new(_Atomic uint64_t, (1 << SLAB_MAP_BITS) / 64);
+    if (atomic_compare_exchange_strong(slot, &leaf, new_leaf)) {
+        return new_leaf;
+    }
+    p_delete(&new_leaf);
+    return leaf;
+}
+
+static void mem_slab_map_set(const mem_slab_t *slab, bool set)
+{
+    uintptr_t n = (uintptr_t)slab / SLAB_SIZE;
+    _Atomic uint64_t *leaf = mem_slab_map_leaf(n);
+    uint64_t bit = 1ULL << (n % 64);
+
+    n &= (1 << SLAB_MAP_BITS) - 1;
+    if (set) {
+        atomic_fetch_or_explicit(&leaf[n / 64], bit, memory_order_release);
+    } else {
+        atomic_fetch_and_explicit(&leaf[n / 64], ~bit, memory_order_release);
+    }
+}
+
+static ALWAYS_INLINE mem_slab_t *mem_slab_of(const void *mem)
+{
+    uintptr_t n = (uintptr_t)mem / SLAB_SIZE;
+    _Atomic uint64_t *leaf;
+
+    /* A block is only freed once its slab is registered, the leaf and the
+     * bit are therefore already visible to this thread. */
+    leaf = atomic_load_explicit(&_G.slab_map[n >> SLAB_MAP_BITS],
+                                memory_order_relaxed);
+    if (leaf) {
+        uintptr_t pos = n & ((1 << SLAB_MAP_BITS) - 1);
+        uint64_t  bit = 1ULL << (n % 64);
+
+        if (atomic_load_explicit(&leaf[pos / 64], memory_order_relaxed) & bit)
+        {
+            return (mem_slab_t *)(n * SLAB_SIZE);
+        }
+    }
+    return container_of((void *)mem, mem_slab_t, area);
+}
+
+static size_t mem_slab_usable_size(const mem_slab_t *slab)
+{
+    if (slab->klass == SLAB_LARGE) {
+        return slab->size;
+    }
+    return mem_slab_class_sizes_g[slab->klass];
+}
+
+/* }}} */
+/* {{{ Depot */
+
+/* Called with the pool locked. */
+static void mem_slab_grow(mem_slab_pool_t *pool, unsigned klass)
+{
+    mem_slab_class_t *c = &pool->classes[klass];
+    mem_slab_t *slab;
+
+    slab = pa_new_extra_raw(mem_slab_t, SLAB_SIZE - sizeof(mem_slab_t),
+                            SLAB_SIZE);
+    slab->pool  = pool;
+    slab->klass = klass;
+    slab->size  = SLAB_SIZE - sizeof(mem_slab_t);
+    mem_slab_map_set(slab, true);
+    dlist_add_tail(&pool->slabs, &slab->slab_list);
+    pool->nb_slabs++;
+    pool->map_size += SLAB_SIZE;
+    pool->map_size_hwm = MAX(pool->map_size_hwm, pool->map_size);
+
+    c->bump     = slab->area;
+    c->bump_end = slab->area + slab->size;
+}
+
+static __attribute__((noinline))
+void mem_slab_refill(mem_slab_pool_t *pool, unsigned klass,
+                     mem_slab_mag_t *mag)
+{
+    mem_slab_class_t *c = &pool->classes[klass];
+    size_t size = mem_slab_class_sizes_g[klass];
+
+    spin_lock(&pool->lock);
+    pool->refills++;
+    while (mag->count < SLAB_MAG_SIZE / 2 && c->freelist) {
+        void *blk = c->freelist;
+
+        c->freelist = *(void **)blk;
+        mag->blocks[mag->count++] = blk;
+    }
+    while (mag->count < SLAB_MAG_SIZE / 2) {
+        if (c->bump + size > c->bump_end) {
+            if (mag->count) {
+                break;
+            }
+            mem_slab_grow(pool, klass);
+        }
+        mag->blocks[mag->count++] = c->bump;
+        c->bump += size;
+    }
+    spin_unlock(&pool->lock);
+}
+
+static __attribute__((noinline))
+void mem_slab_flush(mem_slab_pool_t *pool, unsigned klass,
+                    mem_slab_mag_t *mag, uint32_t count)
+{
+    mem_slab_class_t *c = &pool->classes[klass];
+
+    spin_lock(&pool->lock);
+    pool->flushes++;
+    while (count-- > 0) {
+        void *blk = mag->blocks[--mag->count];
+
+        *(void **)blk = c->freelist;
+        c->freelist = blk;
+    }
+    spin_unlock(&pool->lock);
+}
+
+/* }}} */
+/* {{{ Thread caches */
+
+static __attribute__((noinline))
+mem_slab_tcache_t *mem_slab_tcache_slow(mem_slab_pool_t *pool)
+{
+    mem_slab_tcache_t **tcp = &mem_slab_tls_g.caches;
+    mem_slab_tcache_t *tc;
+
+    mem_slab_tls_g.last = NULL;
+    while ((tc = *tcp)) {
+        if (atomic_load_explicit(&tc->dead, memory_order_acquire)) {
+            /* The pool is gone, and so are the blocks of the magazines. */
+            *tcp = tc->next;
+            p_delete(&tc);
+            continue;
+        }
+        if (tc->pool == pool) {
+            return mem_slab_tls_g.last = tc;
+        }
+        tcp = &tc->next;
+    }
+
+    tc = p_new(mem_slab_tcache_t, 1);
+    tc->pool = pool;
+    spin_lock(&pool->lock);
+    dlist_add_tail(&pool->tcaches, &tc->tcache_list);
+    spin_unlock(&pool->lock);
+
+    tc->next = mem_slab_tls_g.caches;
+    mem_slab_tls_g.caches = tc;
+    return mem_slab_tls_g.last = tc;
+}
+
+static ALWAYS_INLINE mem_slab_tcache_t *mem_slab_tcache(mem_slab_pool_t *pool)
+{
+    mem_slab_tcache_t *tc = mem_slab_tls_g.last;
+
+    /* A deleted pool can be reallocated at the same address. */
+    if (likely(tc && tc->pool == pool
+    &&  !atomic_load_explicit(&tc->dead, memory_order_relaxed)))
+    {
+        return tc;
+    }
+    return mem_slab_tcache_slow(pool);
+}
+
+/* Called with _G.all_pools_lock held, so that the pool cannot be deleted
+ * meanwhile. */
+static void mem_slab_tcache_release(mem_slab_tcache_t *tc)
+{
+    mem_slab_pool_t *pool = tc->pool;
+
+    spin_lock(&pool->lock);
+    for (int i = 0; i < SLAB_NB_CLASSES; i++) {
+        mem_slab_class_t *c = &pool->classes[i];
+        mem_slab_mag_t *mag = &tc->mags[i];
+
+        while (mag->count) {
+            void *blk = mag->blocks[--mag->count];
+
+            *(void **)blk = c->freelist;
+            c->freelist = blk;
+        }
+        c->allocs += mag->allocs;
+        c->frees  += mag->frees;
+    }
+    dlist_remove(&tc->tcache_list);
+    spin_unlock(&pool->lock);
+}
+
+static void mem_slab_thread_exit(void)
+{
+    mem_slab_tcache_t *tc = mem_slab_tls_g.caches;
+
+    spin_lock(&_G.all_pools_lock);
+    while (tc) {
+        mem_slab_tcache_t *next = tc->next;
+
+        if (!atomic_load(&tc->dead)) {
+            mem_slab_tcache_release(tc);
+        }
+        p_delete(&tc);
+        tc = next;
+    }
+    spin_unlock(&_G.all_pools_lock);
+    mem_slab_tls_g.caches = NULL;
+    mem_slab_tls_g.last   = NULL;
+}
+thr_hooks(NULL, mem_slab_thread_exit);
+
+/* }}} */
+/* {{{ Allocation */
+
+static __attribute__((noinline))
+void *mem_slab_alloc_large(mem_slab_pool_t *pool, size_t size)
+{
+    mem_slab_t *slab = p_new_extra_raw(mem_slab_t, size);
+
+    slab->pool  = pool;
+    slab->klass = SLAB_LARGE;
+    slab->size  = size;
+
+    spin_lock(&pool->lock);
+    dlist_add_tail(&pool->slabs, &slab->slab_list);
+    pool->nb_large++;
+    pool->large_size += size;
+    pool->large_allocated += size;
+    pool->map_size   += sizeof(mem_slab_t) + size;
+    pool->map_size_hwm = MAX(pool->map_size_hwm, pool->map_size);
+    spin_unlock(&pool->lock);
+
+    return slab->area;
+}
+
+static void mem_slab_free_large(mem_slab_pool_t *pool, mem_slab_t *slab)
+{
+    spin_lock(&pool->lock);
+    dlist_remove(&slab->slab_list);
+    pool->nb_large--;
+    pool->large_size -= slab->size;
+    pool->map_size   -= sizeof(mem_slab_t) + slab->size;
+    spin_unlock(&pool->lock);
+
+    p_delete(&slab);
+}
+
+static void *mem_slab_alloc(mem_pool_t *mp, size_t size, size_t alignment,
+                            mem_flags_t flags)
+{
+    mem_slab_pool_t *pool = container_of(mp, mem_slab_pool_t, funcs);
+    mem_slab_mag_t *mag;
+    unsigned klass;
+    void *res;
+
+    if (unlikely(size == 0)) {
+        return MEM_EMPTY_ALLOC;
+    }
+    if (unlikely(alignment > CACHE_LINE_SIZE)) {
+        e_panic("mem_slab_pool does not support alignments greater "
+                "than %d", CACHE_LINE_SIZE);
+    }
+
+    /* All the blocks of a class are aligned on the largest power of 2 that
+     * divides the size of the class. */
+    size = ROUND_UP(size, alignment);
+    if (unlikely(size > SLAB_MAX_SIZE)) {
+        res = mem_slab_alloc_large(pool, size);
+    } else {
+        klass = mem_slab_class(size);
+        mag = &mem_slab_tcache(pool)->mags[klass];
+        if (unlikely(!mag->count)) {
+            mem_slab_refill(pool, klass, mag);
+        }
+        mag->allocs++;
+        res = mag->blocks[--mag->count];
+    }
+
+    if (!(flags & MEM_RAW)) {
+        memset(res, 0, size);
+    }
+    return res;
+}
+
+static void mem_slab_free(mem_pool_t *mp, void *mem)
+{
+    mem_slab_pool_t *pool = container_of(mp, mem_slab_pool_t, funcs);
+    mem_slab_t *slab;
+    mem_slab_mag_t *mag;
+
+    if (!mem || mem == MEM_EMPTY_ALLOC) {
+        return;
+    }
+
+    slab = mem_slab_of(mem);
+    assert (slab->pool == pool);
+    if (unlikely(slab->klass == SLAB_LARGE)) {
+        mem_slab_free_large(pool, slab);
+        return;
+    }
+
+    mag = &mem_slab_tcache(pool)->mags[slab->klass];
+    if (unlikely(mag->count == SLAB_MAG_SIZE)) {
+        mem_slab_flush(pool, slab->klass, mag, SLAB_MAG_SIZE / 2);
+    }
+    mag->frees++;
+    mag->blocks[mag->count++] = mem;
+}
+
+static void *mem_slab_realloc(mem_pool_t *mp, void *mem, size_t oldsize,
+                              size_t size, size_t alignment,
+                              mem_flags_t flags)
+{
+    size_t usable;
+    void *res;
+
+    if (!mem || mem == MEM_EMPTY_ALLOC) {
+        return mem_slab_alloc(mp, size, alignment, flags);
+    }
+    if (size == 0) {
+        mem_slab_free(mp, mem);
+        return MEM_EMPTY_ALLOC;
+    }
+
+    usable = mem_slab_usable_size(mem_slab_of(mem));
+    if (oldsize == MEM_UNKNOWN) {
+        assert (flags & MEM_RAW);
+        oldsize = usable;
+    }
+
+    if (size <= usable && ((uintptr_t)mem & (alignment - 1)) == 0) {
+        res = mem;
+    } else {
+        res = mem_slab_alloc(mp, size, alignment, flags | MEM_RAW);
+        memcpy(res, mem, MIN(oldsize, size));
+        mem_slab_free(mp, mem);
+    }
+
+    if (!(flags & MEM_RAW) && size > oldsize) {
+        memset((byte *)res + oldsize, 0, size - oldsize);
+    }
+    return res;
+}
+
+/* }}} */
+/* {{{ Pool */
+
+static mem_pool_t const mem_slab_pool_funcs = {
+    .malloc   = &mem_slab_alloc,
+    .realloc  = &mem_slab_realloc,
+    .free     = &mem_slab_free,
+    .mem_pool = MEM_OTHER,
+    .min_alignment = 16
+};
+
+mem_pool_t *mem_slab_pool_new(const char *name)
+{
+    mem_slab_pool_t *pool = p_new(mem_slab_pool_t, 1);
+
+    pool->name = p_strdup(name);
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        pool->funcs = mem_pool_libc;
+        return &pool->funcs;
+    }
+
+    STATIC_ASSERT(sizeof(mem_slab_t) == CACHE_LINE_SIZE);
+    pool->funcs = mem_slab_pool_funcs;
+    dlist_init(&pool->slabs);
+    dlist_init(&pool->tcaches);
+
+    spin_lock(&_G.all_pools_lock);
+    dlist_add_tail(&_G.all_pools, &pool->pool_list);
+    spin_unlock(&_G.all_pools_lock);
+
+    return &pool->funcs;
+}
+
+void mem_slab_pool_delete(mem_pool_t **poolp)
+{
+    mem_slab_pool_t *pool;
+
+    if (!*poolp) {
+        return;
+    }
+
+    pool = container_of(*poolp, mem_slab_pool_t, funcs);
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        p_delete(&pool->name);
+        p_delete(poolp);
+        return;
+    }
+
+    /* The caches are owned by their threads, they are only flagged here
+     * and the threads free them lazily. */
+    spin_lock(&_G.all_pools_lock);
+    dlist_remove(&pool->pool_list);
+    dlist_for_each_entry(mem_slab_tcache_t, tc, &pool->tcaches,
+                         tcache_list)
+    {
+        atomic_store_explicit(&tc->dead, true, memory_order_release);
+    }
+    spin_unlock(&_G.all_pools_lock);
+
+    if (mem_slab_tls_g.last && mem_slab_tls_g.last->pool == pool) {
+        mem_slab_tls_g.last = NULL;
+    }
+
+    dlist_for_each_entry(mem_slab_t, slab, &pool->slabs, slab_list) {
+        if (slab->klass != SLAB_LARGE) {
+            mem_slab_map_set(slab, false);
+        }
+        p_delete(&slab);
+    }
+    p_delete(&pool->name);
+    p_delete(&pool->owner_name);
+    p_delete(poolp);
+}
+
+/* Called with _G.all_pools_lock held. */
+static void mem_slab_pool_get_stats(mem_slab_pool_t *pool, size_t *used,
+                                    uint64_t *allocated, uint32_t *nb_threads)
+{
+    size_t res = 0;
+    uint64_t total = pool->large_allocated;
+    uint32_t threads = 0;
+
+    spin_lock(&pool->lock);
+    for (int i = 0; i < SLAB_NB_CLASSES; i++) {
+        uint64_t allocs = pool->classes[i].allocs;
+        uint64_t frees  = pool->classes[i].frees;
+
+        dlist_for_each_entry(mem_slab_tcache_t, tc, &pool->tcaches,
+                             tcache_list)
+        {
+            allocs += tc->mags[i].allocs;
+            frees  += tc->mags[i].frees;
+        }
+        /* The counters of the other threads are read racily, and a block
+         * can be freed by another thread than the one that allocated it. */
+        if (allocs > frees) {
+            res += (allocs - frees) * mem_slab_class_sizes_g[i];
+        }
+        total += allocs * mem_slab_class_sizes_g[i];
+    }
+    dlist_for_each(n, &pool->tcaches) {
+        threads++;
+    }
+    res += pool->large_size;
+    spin_unlock(&pool->lock);
+
+    *used = res;
+    if (allocated) {
+        *allocated = total;
+    }
+    if (nb_threads) {
+        *nb_threads = threads;
+    }
+}
+
+void mem_slab_pool_stats(mem_pool_t *mp, ssize_t *allocated, ssize_t *used)
+{
+    mem_slab_pool_t *pool = container_of(mp, mem_slab_pool_t, funcs);
+    size_t res;
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        return;
+    }
+
+    spin_lock(&_G.all_pools_lock);
+    mem_slab_pool_get_stats(pool, &res, NULL, NULL);
+    spin_unlock(&_G.all_pools_lock);
+
+    *allocated = pool->map_size;
+    *used      = res;
+}
+
+void mem_slab_pools_print_stats(void)
+{
+    t_scope;
+    qv_t(table_hdr) hdr;
+    qv_t(table_data) rows;
+    table_hdr_t hdr_data[] = { {
+            .title = LSTR_IMMED("SLAB POOL NAME"),
+        }, {
+            .title = LSTR_IMMED("POINTER"),
+        }, {
+            .title = LSTR_IMMED("SIZE"),
+        }, {
+            .title = LSTR_IMMED("USED"),
+        }, {
+            .title = LSTR_IMMED("NB SLABS"),
+        }, {
+            .title = LSTR_IMMED("NB LARGE"),
+        }, {
+            .title = LSTR_IMMED("THREADS"),
+        }, {
+            .title = LSTR_IMMED("REFILLS"),
+        }, {
+            .title = LSTR_IMMED("FLUSHES"),
+        }
+    };
+    uint32_t hdr_size = countof(hdr_data);
+    size_t   total_size = 0;
+    size_t   total_used = 0;
+    uint32_t total_nb_slabs = 0;
+    int nb_slab_pool = 0;
+
+    /* bypass mem_pool if demanded */
+    if (!mem_pool_is_enabled()) {
+        return;
+    }
+
+    qv_init_static(&hdr, hdr_data, hdr_size);
+    t_qv_init(&rows, 200);
+
+#define ADD_NUMBER_FIELD(_what)  \
+    do {                                                                     \
+        t_SB(_buf, 16);                                                      \
+                                                                             \
+        sb_add_int_fmt(&_buf, _what, ',');                                   \
+        qv_append(tab, LSTR_SB_V(&_buf));                                    \
+    } while (0)
+
+    spin_lock(&_G.all_pools_lock);
+
+    dlist_for_each_entry(mem_slab_pool_t, sp, &_G.all_pools, pool_list) {
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+        uint32_t nb_threads;
+        size_t used;
+
+        mem_slab_pool_get_stats(sp, &used, NULL, &nb_threads);
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, t_lstr_fmt("%s", sp->name));
+        qv_append(tab, t_lstr_fmt("%p", sp));
+
+        ADD_NUMBER_FIELD(sp->map_size);
+        ADD_NUMBER_FIELD(used);
+        ADD_NUMBER_FIELD(sp->nb_slabs);
+        ADD_NUMBER_FIELD(sp->nb_large);
+        ADD_NUMBER_FIELD(nb_threads);
+        ADD_NUMBER_FIELD(sp->refills);
+        ADD_NUMBER_FIELD(sp->flushes);
+
+        nb_slab_pool++;
+        total_size     += sp->map_size;
+        total_used     += used;
+        total_nb_slabs += sp->nb_slabs;
+    }
+
+    spin_unlock(&_G.all_pools_lock);
+
+    if (nb_slab_pool) {
+        SB_1k(buf);
+        qv_t(lstr) *tab = qv_growlen(&rows, 1);
+
+        t_qv_init(tab, hdr_size);
+        qv_append(tab, LSTR("TOTAL"));
+        qv_append(tab, LSTR("-"));
+
+        ADD_NUMBER_FIELD(total_size);
+        ADD_NUMBER_FIELD(total_used);
+        ADD_NUMBER_FIELD(total_nb_slabs);
+        for (uint32_t i = 5; i < hdr_size; i++) {
+            qv_append(tab, LSTR("-"));
+        }
+
+        sb_add_table(&buf, &hdr, &rows);
+        sb_shrink(&buf, 1);
+        logger_notice(&_G.logger, "slab pools summary:\n%*pM",
+                      SB_FMT_ARG(&buf));
+    }
+#undef ADD_NUMBER_FIELD
+}
+
+bool mem_slab_pool_set_owner(mem_pool_t *mp, const char *owner)
+{
+    mem_slab_pool_t *pool = container_of(mp, mem_slab_pool_t, funcs);
+
+    if (mp->malloc != &mem_slab_alloc) {
+        return false;
+    }
+
+    spin_lock(&_G.all_pools_lock);
+    p_delete(&pool->owner_name);
+    pool->owner_name = owner ? p_strdup(owner) : NULL;
+    spin_unlock(&_G.all_pools_lock);
+    return true;
+}
+
+void mem_slab_pools_get_stats(mem_pool_stats_cb_f *cb, void *priv)
+{
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(mem_slab_pool_t, sp, &_G.all_pools, pool_list) {
+        mem_pool_stats_t st = {
+            .type         = "slab",
+            .name         = sp->name,
+            .owner        = sp->owner_name,
+            .pool         = sp,
+            .reserved     = sp->map_size,
+            .reserved_hwm = sp->map_size_hwm,
+        };
+        size_t used;
+
+        mem_slab_pool_get_stats(sp, &used, &st.allocated, NULL);
+        st.used = used;
+        (*cb)(&st, priv);
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+
+/* }}} */
+/* {{{ Module (for print_state method) */
+
+static int core_mem_slab_initialize(void *arg)
+{
+    return 0;
+}
+
+static int core_mem_slab_shutdown(void)
+{
+    return 0;
+}
+
+MODULE_BEGIN(core_mem_slab)
+    MODULE_IMPLEMENTS_VOID(print_state, &mem_slab_pools_print_stats);
+MODULE_END()
+
+/* }}} */
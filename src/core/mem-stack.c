@@ -80,6 +80,7 @@ static mem_stack_blk_t *blk_create(mem_stack_pool_t *sp,
     dlist_add_after(&cur->blk_list, &blk->blk_list);
 
     sp->stacksize += blk->size;
+    sp->stacksize_hwm = MAX(sp->stacksize_hwm, sp->stacksize);
     sp->nb_blocks++;
 
 #ifdef MEM_BENCH
@@ -214,6 +215,7 @@ static void *sp_reserve(mem_stack_pool_t *sp, size_t asked, size_t alignment,
     }
     sp->alloc_sz += asked;
     sp->alloc_nb += 1;
+    sp->allocated += asked;
 
     return res;
 }
@@ -320,6 +322,7 @@ static void *sp_realloc(mem_pool_t *_sp, void *mem, size_t oldsize,
         sp->alloc_sz += sizediff;
 
         if (likely(sizediff >= 0)) {
+            sp->allocated += sizediff;
             mem_tool_allow_memory(res + oldsize, sizediff, false);
 
             if (!(flags & MEM_RAW)) {
@@ -505,6 +508,10 @@ mem_stack_pool_t *mem_stack_pool_init(mem_stack_pool_t *sp, const char *name,
     sp->stacksize = 0;
     sp->nb_blocks = 0;
 
+    sp->stacksize_hwm = 0;
+    sp->allocated     = 0;
+    sp->owner_name    = NULL;
+
 #ifndef NDEBUG
     /* bypass mem_pool if demanded
      * XXX this code is intentionnally
@@ -613,6 +620,7 @@ void mem_stack_pool_wipe(mem_stack_pool_t *sp)
     spin_unlock(&_G.all_pools_lock);
 
     p_delete(&sp->name);
+    p_delete(&sp->owner_name);
 
 #ifdef MEM_BENCH
     mem_bench_delete(&sp->mem_bench);
@@ -723,6 +731,39 @@ void mem_stack_print_pools_stats(void) {
 #endif
 }
 
+bool mem_stack_set_owner(mem_pool_t *mp, const char *owner)
+{
+    mem_stack_pool_t *sp = mem_stack_get_pool(mp);
+
+    spin_lock(&_G.all_pools_lock);
+    p_delete(&sp->owner_name);
+    sp->owner_name = owner ? p_strdup(owner) : NULL;
+    spin_unlock(&_G.all_pools_lock);
+    return true;
+}
+
+void mem_stack_pools_get_stats(mem_pool_stats_cb_f *cb, void *priv)
+{
+    spin_lock(&_G.all_pools_lock);
+    dlist_for_each_entry(mem_stack_pool_t, sp, &_G.all_pools, pool_list) {
+        /* The pools of the other threads are read racily, and the bytes in
+         * use are not tracked. */
+        mem_pool_stats_t st = {
+            .type         = "stack",
+            .name         = sp->name,
+            .owner        = sp->owner_name,
+            .pool         = sp,
+            .reserved     = sp->stacksize,
+            .reserved_hwm = sp->stacksize_hwm,
+            .used         = -1,
+            .allocated    = sp->allocated,
+        };
+
+        (*cb)(&st, priv);
+    }
+    spin_unlock(&_G.all_pools_lock);
+}
+
 #ifndef NDEBUG
 void mem_stack_pool_protect(mem_stack_pool_t *sp, const mem_stack_frame_t *up_to)
 {
@@ -130,6 +130,13 @@ typedef struct mem_stack_pool_t {
     uint32_t             nb_blocks;  /*< blk_create / blk_destroy */
     time_t               last_reset; /*< mem_stack_pool_(check_)reset */
 
+    /* accounting, see mem_pools_get_stats() */
+    size_t               stacksize_hwm; /*< blk_create */
+    uint64_t             allocated;     /*< alloc, unlike alloc_sz it is
+                                         *  neither divided nor lowered by
+                                         *  the shrinking reallocs */
+    char * nullable      owner_name;
+
     dlist_t        pool_list;
     char * nonnull name;
     pthread_t      pthread_id;
@@ -697,6 +697,36 @@ void mem_fifo_pool_stats(mem_pool_t * nonnull mp, ssize_t * nonnull allocated,
 void mem_fifo_pool_print_stats(mem_pool_t * nonnull mp);
 void mem_fifo_pools_print_stats(void);
 
+/* }}} */
+/* Mem-slab Pool {{{ */
+
+/** Create a new slab pool.
+ *
+ * The slab pool is a general purpose allocator tuned for the small objects
+ * that are allocated and freed at a high rate by several threads. The
+ * allocations up to 4096 bytes are rounded to a size class, and served by
+ * a cache owned by the calling thread, without any lock in the common
+ * case. The blocks can be freed by any thread.
+ *
+ * The memory of the slabs is only given back to the system when the pool
+ * is deleted. Alignments greater than CACHE_LINE_SIZE are not supported.
+ */
+mem_pool_t * nonnull mem_slab_pool_new(const char * nonnull name)
+    __leaf __attribute__((malloc));
+
+/** Delete a slab pool.
+ *
+ * All the blocks allocated in the pool are released, and the pool must not
+ * be used by any thread anymore.
+ */
+void mem_slab_pool_delete(mem_pool_t * nullable * nonnull poolp)
+    __leaf;
+void mem_slab_pool_stats(mem_pool_t * nonnull mp, ssize_t * nonnull allocated,
+                         ssize_t * nonnull used)
+    __leaf;
+
+void mem_slab_pools_print_stats(void);
+
 /* }}} */
 /* Mem-ring Pool {{{ */
 
@@ -713,6 +743,22 @@ void mem_fifo_pools_print_stats(void);
  */
 mem_pool_t * nonnull mem_ring_new(const char * nonnull name, int initialsize);
 
+/** Create a new multi-producer memory ring-pool.
+ *
+ * Same as mem_ring_new(), except that several threads can allocate (and
+ * reallocate) concurrently in the active frame: the allocations reserve
+ * their memory in the current block with an atomic operation, the pool lock
+ * is only taken when a new block is needed.
+ *
+ * The frame operations (mem_ring_newframe(), mem_ring_seal(),
+ * mem_ring_release(), ...) keep their semantics, and must not race with
+ * allocations in the frames they affect: the caller is responsible for
+ * synchronizing the producers with the thread that seals the frame. In
+ * particular, a frame can still be released from any thread once sealed.
+ */
+mem_pool_t * nonnull mem_ring_new_mt(const char * nonnull name,
+                                     int initialsize);
+
 /** Delete the given memory ring-pool */
 void mem_ring_delete(mem_pool_t * nullable * nonnull) __leaf;
 
@@ -872,6 +918,72 @@ void r_pool_destroy(void) __leaf;
 #define r_strdup(p)        mp_strdup(r_pool(), (p))
 
 /* }}} */
+/* Pools accounting {{{ */
+
+/** Memory accounting of a pool, see mem_pools_get_stats(). */
+typedef struct mem_pool_stats_t {
+    /** Type of the pool: "fifo", "ring", "slab" or "stack". */
+    const char * nonnull type;
+    const char * nonnull name;
+    /** Owner of the pool, see mem_pool_set_owner(). */
+    const char * nullable owner;
+    /** Address of the pool, that identifies it during its life. */
+    const void * nonnull pool;
+
+    /** Bytes reserved by the pool from the system. */
+    size_t reserved;
+    /** Highest value of \ref reserved since the creation of the pool. */
+    size_t reserved_hwm;
+    /** Bytes in use in the pool, -1 if the pool does not know it. */
+    ssize_t used;
+    /** Bytes allocated since the creation of the pool, never decreases. */
+    uint64_t allocated;
+} mem_pool_stats_t;
+
+/** Tag a pool with the name of the subsystem that owns it.
+ *
+ * The owner is reported in the statistics of the pool, so that the memory
+ * of several pools can be accounted to the same subsystem. It is ignored
+ * for the pools that are not accounted (libc, static, ...) and when the
+ * pools are disabled.
+ *
+ * \param[in] owner  name of the owner, copied, NULL to untag the pool.
+ */
+void mem_pool_set_owner(mem_pool_t * nonnull mp, const char * nullable owner);
+
+typedef void (mem_pool_stats_cb_f)(const mem_pool_stats_t * nonnull st,
+                                   void * nullable priv);
+
+/** Get the accounting of all the fifo, ring, slab and stack pools.
+ *
+ * \p cb is called once per live pool, with statistics that are only valid
+ * during the call. It is called with the lock of the pools of its type
+ * held, so it must not create nor delete pools.
+ *
+ * The statistics of the pools owned by other threads (stack pools) are read
+ * without synchronization, and can be slightly outdated.
+ */
+void mem_pools_get_stats(mem_pool_stats_cb_f * nonnull cb,
+                         void * nullable priv);
+
+/* Implemented by each type of pool for the functions above, the setters
+ * return false when the pool is not of their type. */
+bool mem_fifo_pool_set_owner(mem_pool_t * nonnull mp,
+                             const char * nullable owner);
+bool mem_ring_set_owner(mem_pool_t * nonnull mp, const char * nullable owner);
+bool mem_slab_pool_set_owner(mem_pool_t * nonnull mp,
+                             const char * nullable owner);
+bool mem_stack_set_owner(mem_pool_t * nonnull mp,
+                         const char * nullable owner);
+void mem_fifo_pools_get_stats(mem_pool_stats_cb_f * nonnull cb,
+                              void * nullable priv);
+void mem_ring_pools_get_stats(mem_pool_stats_cb_f * nonnull cb,
+                              void * nullable priv);
+void mem_slab_pools_get_stats(mem_pool_stats_cb_f * nonnull cb,
+                              void * nullable priv);
+void mem_stack_pools_get_stats(mem_pool_stats_cb_f * nonnull cb,
+                               void * nullable priv);
+
 /* Alloca {{{ */
 
 #define p_alloca_raw(type_t, count)                                          \
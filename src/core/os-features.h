@@ -38,6 +38,15 @@
 # endif
 #endif
 
+/* <linux/io_uring.h> availability */
+#ifdef OS_LINUX
+# if !defined(HAVE_LINUX_IO_URING_H) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   define HAVE_LINUX_IO_URING_H
+#  endif
+# endif
+#endif
+
 #ifndef SO_FILEEXT
 # define SO_FILEEXT  ".so"
 #endif
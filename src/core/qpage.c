@@ -67,6 +67,10 @@
 #define QDB_MADVISE_THRESHOLD  (1 << (20 - QPAGE_SHIFT))
 #define QPAGE_ALLOC_MIN        (16 << (20 - QPAGE_SHIFT))
 
+#define QPAGE_HUGE_SHIFT       21U
+#define QPAGE_HUGE_SIZE        ((uintptr_t)1 << QPAGE_HUGE_SHIFT)
+#define QPAGE_HUGE_PAGES       (1U << (QPAGE_HUGE_SHIFT - QPAGE_SHIFT))
+
 typedef struct qpage_t {
     uint8_t data[QPAGE_SIZE];
 } qpage_t;
@@ -89,6 +93,7 @@ typedef struct page_run_t {
     qpage_t     *mem_pages;
     uint32_t     npages;
     uint32_t     segment;
+    bool         huge;     /* backed by huge pages, aligned on them */
     page_desc_t  pages[];
 } page_run_t;
 
@@ -98,6 +103,7 @@ static struct {
     page_desc_t **blks; /* array of CLASSES elements. */
     qv_t(pgd)     segs;
     spinlock_t    lock;
+    qpage_huge_t  huge;
 } qpages_g;
 #define _G  qpages_g
 
@@ -307,10 +313,12 @@ static inline uint32_t blk_cut(page_desc_t *blk)
 static NEVER_INLINE int create_arena(size_t npages)
 {
     size_t pgsize = getpagesize();
-    size_t size, offset;
+    size_t align  = QPAGE_SIZE > pgsize ? QPAGE_SIZE : 0;
+    size_t size;
     page_desc_t *blk, *end;
     page_run_t *run;
-    qpage_t *pgs;
+    qpage_t *pgs = MAP_FAILED;
+    bool huge = false;
 
     if (npages < QPAGE_ALLOC_MIN) {
         npages = QPAGE_ALLOC_MIN;
@@ -319,11 +327,29 @@ static NEVER_INLINE int create_arena(size_t npages)
             npages = 1U << (bsr32(npages) + 1);
     }
     size = npages * QPAGE_SIZE;
-    if (QPAGE_SIZE > pgsize)
-        size += QPAGE_SIZE;
-    pgs  = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
-    if (pgs == MAP_FAILED)
-        return -1;
+
+#ifdef MAP_HUGETLB
+    /* The size of the arena is a multiple of the huge page size, and
+     * hugetlb mappings are always aligned on it. When no huge page is
+     * reserved, fall back on transparent huge pages.
+     */
+    if (_G.huge == QPAGE_HUGE_HUGETLB) {
+        pgs = mmap(0, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+        huge = pgs != MAP_FAILED;
+    }
+#endif
+    if (pgs == MAP_FAILED) {
+        if (_G.huge != QPAGE_HUGE_NONE) {
+            align = MAX(align, QPAGE_HUGE_SIZE);
+        }
+        if (align > pgsize)
+            size += align;
+        pgs = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                   -1, 0);
+        if (pgs == MAP_FAILED)
+            return -1;
+    }
     mem_tool_disallow_memory(pgs, size);
 
     run = calloc(1, sizeof(page_run_t) + (npages + 1) * sizeof(page_desc_t));
@@ -332,23 +358,26 @@ static NEVER_INLINE int create_arena(size_t npages)
         munmap(pgs, size);
         return -1;
     }
-    if (QPAGE_SIZE > pgsize) {
-        offset = (uintptr_t)pgs & QPAGE_MASK;
-        if (offset) {
-            npages--;
-            mem_tool_allow_memory(pgs, QPAGE_SIZE - offset, true);
-            munmap(pgs, QPAGE_SIZE - offset);
-            pgs = (qpage_t *)((uintptr_t)pgs + QPAGE_SIZE - offset);
-            mem_tool_allow_memory(pgs + npages, offset, true);
-            munmap(pgs + npages, offset);
-        } else {
-            mem_tool_allow_memory(pgs + npages, QPAGE_SIZE, true);
-            munmap(pgs + npages, QPAGE_SIZE);
+    if (!huge && align > pgsize) {
+        size_t head = ROUND_UP((uintptr_t)pgs, align) - (uintptr_t)pgs;
+
+        if (head) {
+            mem_tool_allow_memory(pgs, head, true);
+            munmap(pgs, head);
+            pgs = (qpage_t *)((uintptr_t)pgs + head);
         }
+        mem_tool_allow_memory(pgs + npages, align - head, true);
+        munmap(pgs + npages, align - head);
     }
+#ifdef MADV_HUGEPAGE
+    if (!huge && _G.huge != QPAGE_HUGE_NONE) {
+        huge = madvise(pgs, npages * QPAGE_SIZE, MADV_HUGEPAGE) == 0;
+    }
+#endif
     run->mem_pages = pgs;
     run->npages    = npages;
     run->segment   = _G.segs.len;
+    run->huge      = huge;
     qv_append(&_G.segs, run->pages);
     for (uint32_t i = 0; i <= npages; i++) {
         run->pages[i].blkno = i;
@@ -367,6 +396,20 @@ static NEVER_INLINE int create_arena(size_t npages)
 /* Public stuff                                                           */
 /**************************************************************************/
 
+/* Gives the physical memory of the pages back to the system, returns whether
+ * the pages are clean afterwards. Releasing parts of hugetlb pages fails on
+ * older kernels.
+ */
+static bool release_pages(qpage_t *pages, size_t npages)
+{
+#ifdef __linux__
+    return madvise(pages, npages * QPAGE_SIZE, MADV_DONTNEED) == 0;
+#else
+    return mmap(pages, npages * QPAGE_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0) != MAP_FAILED;
+#endif
+}
+
 static void
 free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
 {
@@ -398,13 +441,11 @@ free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
     blk_insert(blk, bsz);
 
     if (bsz == run->npages) {
-#ifdef __linux__
-        madvise(run->mem_pages, bsz * QPAGE_SIZE, MADV_DONTNEED);
-#else
-        mmap(run->mem_pages, bsz * QPAGE_SIZE, PROT_READ | PROT_WRITE,
-             MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
-#endif
-        blk_set_clean(run->pages, bsz);
+        if (release_pages(run->mem_pages, bsz)) {
+            blk_set_clean(run->pages, bsz);
+        } else {
+            blk_set_dirty(run->pages, bsz);
+        }
         mem_tool_disallow_memory(run->mem_pages, bsz * QPAGE_SIZE);
     } else {
         /** Divide virtually the array of run->pages into chunk of size of
@@ -424,33 +465,33 @@ free_n(page_run_t *run, page_desc_t *blk, size_t npages, uint32_t seg)
          * chunk and we can call madvise.
          * If it is not the last used blocks in the chunk, we still need to
          * call blk_set_dirty for these blocks (see (¹)).
+         *
+         * Runs backed by huge pages use chunks of the size of a huge page,
+         * to avoid splitting them.
          */
+        size_t chunk = run->huge ? QPAGE_HUGE_PAGES : QDB_MADVISE_THRESHOLD;
         size_t chunk_begin;
         size_t chunk_end;
 
         /* find the first free chunk */
-        chunk_begin = ROUND(blkno, QDB_MADVISE_THRESHOLD);
+        chunk_begin = ROUND(blkno, chunk);
         if (chunk_begin <= blk_no(blk)) {
-            chunk_begin += QDB_MADVISE_THRESHOLD;
+            chunk_begin += chunk;
         }
         /* find the next non-free chunk */
-        chunk_end = ROUND_UP(blkno + npages, QDB_MADVISE_THRESHOLD);
+        chunk_end = ROUND_UP(blkno + npages, chunk);
         if (chunk_end > blk_no(blk) + bsz) {
-            chunk_end -= QDB_MADVISE_THRESHOLD;
+            chunk_end -= chunk;
         }
 
         if (chunk_begin < chunk_end) {
             const size_t chunk_sz = chunk_end - chunk_begin;
 
-#ifdef __linux__
-            madvise(run->mem_pages + chunk_begin, chunk_sz * QPAGE_SIZE,
-                    MADV_DONTNEED);
-#else
-            mmap(run->mem_pages + chunk_begin, chunk_sz * QPAGE_SIZE,
-                 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED,
-                 -1, 0);
-#endif
-            blk_set_clean(run->pages + chunk_begin, chunk_sz);
+            if (release_pages(run->mem_pages + chunk_begin, chunk_sz)) {
+                blk_set_clean(run->pages + chunk_begin, chunk_sz);
+            } else {
+                blk_set_dirty(run->pages + chunk_begin, chunk_sz);
+            }
             mem_tool_disallow_memory(run->mem_pages + chunk_begin,
                                      chunk_sz * QPAGE_SIZE);
             if (blkno < chunk_begin) {
@@ -697,9 +738,19 @@ void *qpage_dup_n(const void *ptr, size_t n, uint32_t *seg)
     return res;
 }
 
+void qpage_set_huge_pages(qpage_huge_t mode)
+{
+    spin_lock(&_G.lock);
+    _G.huge = mode;
+    spin_unlock(&_G.lock);
+}
+
 static int qpage_initialize(void *arg)
 {
+    qpage_huge_t huge = _G.huge;
+
     p_clear(&_G, 1);
+    _G.huge = huge;
     _G.bits = p_new(size_t, BITS_LEN);
     _G.blks = p_new(page_desc_t *, CLASSES);
     return 0;
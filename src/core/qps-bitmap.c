@@ -229,6 +229,117 @@ qps_bitmap_state_t qps_bitmap_get(qps_bitmap_t *map, uint32_t row)
     }
 }
 
+/* Number of lookups interleaved by qps_bitmap_get_many(). */
+#define QPS_BITMAP_GET_BATCH  16
+
+void qps_bitmap_get_many(qps_bitmap_t *map, const uint32_t *rows,
+                         uint32_t count, qps_bitmap_state_t *states)
+{
+    qps_bitmap_state_t absent;
+    bool is_nullable;
+
+    qps_hptr_deref(map->qps, &map->root_cache);
+    is_nullable = map->root->is_nullable;
+    absent = is_nullable ? QPS_BITMAP_NULL : QPS_BITMAP_0;
+
+    for (uint32_t from = 0; from < count; from += QPS_BITMAP_GET_BATCH) {
+        const struct qps_bitmap_dispatch_node *entries[QPS_BITMAP_GET_BATCH];
+        const uint64_t *words[QPS_BITMAP_GET_BATCH];
+        uint32_t n = MIN(count - from, QPS_BITMAP_GET_BATCH);
+
+        /* Locate and prefetch the entries of the dispatch nodes of the
+         * whole batch before reading any of them, then do the same for
+         * the words of the leaves. */
+        for (uint32_t i = 0; i < n; i++) {
+            qps_bitmap_key_t key = { .key = rows[from + i] };
+            qps_bitmap_node_t dispatch_node = map->root->roots[key.root];
+            const qps_bitmap_dispatch_t *dispatch;
+
+            if (dispatch_node == QPS_HANDLE_NULL) {
+                entries[i] = NULL;
+                continue;
+            }
+            dispatch = qps_pg_deref(map->qps, dispatch_node);
+            entries[i] = &(*dispatch)[key.dispatch];
+            __builtin_prefetch(entries[i]);
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            qps_bitmap_key_t key = { .key = rows[from + i] };
+            const uint64_t *leaf;
+
+            if (!entries[i] || entries[i]->node == 0) {
+                words[i] = NULL;
+                continue;
+            }
+            leaf = qps_pg_deref(map->qps, entries[i]->node);
+            words[i] = &leaf[is_nullable ? key.word_null : key.word];
+            __builtin_prefetch(words[i]);
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            qps_bitmap_key_t key = { .key = rows[from + i] };
+            uint64_t word;
+
+            if (!words[i]) {
+                states[from + i] = absent;
+            } else
+            if (is_nullable) {
+                word = *words[i] >> (key.bit_null * 2);
+                if (!(word & 0x2)) {
+                    states[from + i] = QPS_BITMAP_NULL;
+                } else {
+                    states[from + i] = (qps_bitmap_state_t)(word & 0x1);
+                }
+            } else {
+                word = *words[i] >> key.bit;
+                states[from + i] = (qps_bitmap_state_t)(word & 0x1);
+            }
+        }
+    }
+}
+
+qps_bitmap_state_t qps_bitmap_reader_get(qps_t *qps, qps_handle_t handle,
+                                         uint32_t row)
+{
+    qps_bitmap_key_t key = { .key = row };
+    const qps_bitmap_root_t *root;
+    const qps_bitmap_dispatch_t *dispatch;
+    const uint64_t *leaf;
+    qps_bitmap_state_t unset;
+    bool is_nullable;
+
+    root = qps_handle_reader_deref(qps, handle);
+    if (!root) {
+        return QPS_BITMAP_0;
+    }
+    is_nullable = root->is_nullable;
+    unset = is_nullable ? QPS_BITMAP_NULL : QPS_BITMAP_0;
+
+    dispatch = qps_pg_reader_deref(qps, root->roots[key.root], 3);
+    if (!dispatch) {
+        return unset;
+    }
+    leaf = qps_pg_reader_deref(qps, (*dispatch)[key.dispatch].node,
+                               is_nullable ? 2 : 1);
+    if (!leaf) {
+        return unset;
+    }
+
+    if (is_nullable) {
+        uint64_t word = leaf[key.word_null];
+        word >>= (key.bit_null * 2);
+        if (!(word & 0x2)) {
+            return QPS_BITMAP_NULL;
+        }
+        return (qps_bitmap_state_t)(word & 0x1);
+    } else {
+        uint64_t word = leaf[key.word];
+        word >>= key.bit;
+        return (qps_bitmap_state_t)(word & 0x1);
+    }
+}
+
 qps_bitmap_state_t qps_bitmap_set(qps_bitmap_t *map, uint32_t row)
 {
     qps_bitmap_key_t key = { .key = row };
@@ -392,6 +503,362 @@ void qps_bitmap_compute_stats(qps_bitmap_t *map, size_t *_memory,
     *_slots   = slots;
 }
 
+/* }}} */
+/* Set operations {{{ */
+
+typedef enum qps_bitmap_op_t {
+    QPS_BITMAP_OP_AND,
+    QPS_BITMAP_OP_OR,
+    QPS_BITMAP_OP_AND_NOT,
+} qps_bitmap_op_t;
+
+/* Rows at 1 of a word of a nullable leaf: a row is at 1 when both its bits
+ * are set, the pairs of bits are then compacted to one bit per row. */
+static ALWAYS_INLINE uint32_t nullable_word_ones(uint64_t word)
+{
+    uint64_t x = word & (word >> 1) & UINT64_C(0x5555555555555555);
+
+    x = (x | (x >> 1))  & UINT64_C(0x3333333333333333);
+    x = (x | (x >> 2))  & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    x = (x | (x >> 4))  & UINT64_C(0x00ff00ff00ff00ff);
+    x = (x | (x >> 8))  & UINT64_C(0x0000ffff0000ffff);
+    x = (x | (x >> 16)) & UINT64_C(0x00000000ffffffff);
+    return x;
+}
+
+/* Inverse of nullable_word_ones(): one bit per row on the even bits. */
+static ALWAYS_INLINE uint64_t nullable_word_spread(uint32_t rows)
+{
+    uint64_t x = rows;
+
+    x = (x | (x << 16)) & UINT64_C(0x0000ffff0000ffff);
+    x = (x | (x << 8))  & UINT64_C(0x00ff00ff00ff00ff);
+    x = (x | (x << 4))  & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    x = (x | (x << 2))  & UINT64_C(0x3333333333333333);
+    x = (x | (x << 1))  & UINT64_C(0x5555555555555555);
+    return x;
+}
+
+/* Rows at 1 of the w-th group of 64 rows of a leaf, laid out as in the
+ * leaves of a non-nullable bitmap. */
+static ALWAYS_INLINE
+uint64_t leaf_ones(const uint64_t *leaf, bool is_nullable, unsigned w)
+{
+    if (is_nullable) {
+        return nullable_word_ones(leaf[2 * w])
+            | ((uint64_t)nullable_word_ones(leaf[2 * w + 1]) << 32);
+    }
+    return leaf[w];
+}
+
+static void delete_dispatch_leaf(qps_bitmap_t *map,
+                                 qps_bitmap_dispatch_t *dispatch, unsigned j)
+{
+    qps_pg_unmap(map->qps, (*dispatch)[j].node);
+    (*dispatch)[j].node = 0;
+    (*dispatch)[j].active_bits = 0;
+}
+
+/* Combines the leaf j of a dispatch node of \p map with a leaf of the
+ * other operand, and returns whether it still has rows set. */
+static ALWAYS_INLINE
+bool combine_leaf(qps_bitmap_t *map, qps_bitmap_dispatch_t *dispatch,
+                  unsigned j, const uint64_t *other, bool other_nullable,
+                  qps_bitmap_op_t op)
+{
+    uint64_t *leaf = qps_pg_deref(map->qps, (*dispatch)[j].node);
+    uint32_t bits = 0;
+
+    for (unsigned w = 0; w < QPS_BITMAP_WORD; w++) {
+        uint64_t word = leaf_ones(other, other_nullable, w);
+
+        switch (op) {
+          case QPS_BITMAP_OP_AND:
+            leaf[w] &= word;
+            break;
+          case QPS_BITMAP_OP_OR:
+            leaf[w] |= word;
+            break;
+          case QPS_BITMAP_OP_AND_NOT:
+            leaf[w] &= ~word;
+            break;
+        }
+        bits += bitcount64(leaf[w]);
+    }
+    if (bits == 0) {
+        delete_dispatch_leaf(map, dispatch, j);
+        return false;
+    }
+    (*dispatch)[j].active_bits = bits;
+    return true;
+}
+
+static ALWAYS_INLINE
+void qps_bitmap_combine(qps_bitmap_t *map, qps_bitmap_t *other,
+                        qps_bitmap_op_t op)
+{
+    bool other_nullable;
+
+    qps_hptr_deref(map->qps, &map->root_cache);
+    qps_hptr_deref(other->qps, &other->root_cache);
+    assert (!map->root->is_nullable);
+    assert (map->qps != other->qps
+        ||  map->root_cache.handle != other->root_cache.handle);
+    other_nullable = other->root->is_nullable;
+    map->bitmap_gen++;
+
+    for (unsigned i = 0; i < QPS_BITMAP_ROOTS; i++) {
+        qps_bitmap_key_t key = { .key = 0 };
+        qps_bitmap_dispatch_t *dispatch;
+        const qps_bitmap_dispatch_t *odispatch = NULL;
+        bool empty = true;
+
+        key.root = i;
+        if (other->root->roots[i]) {
+            odispatch = qps_pg_deref(other->qps, other->root->roots[i]);
+        } else
+        if (op != QPS_BITMAP_OP_AND) {
+            /* nothing to add or remove under this root */
+            continue;
+        }
+        if (map->root->roots[i]) {
+            dispatch = qps_pg_deref(map->qps, map->root->roots[i]);
+        } else
+        if (op == QPS_BITMAP_OP_OR) {
+            dispatch = w_deref_dispatch(map, key, true);
+        } else {
+            continue;
+        }
+
+        for (unsigned j = 0; j < QPS_BITMAP_DISPATCH; j++) {
+            const uint64_t *oleaf = NULL;
+
+            if (odispatch && (*odispatch)[j].node) {
+                oleaf = qps_pg_deref(other->qps, (*odispatch)[j].node);
+            }
+            if ((*dispatch)[j].node == 0) {
+                if (op != QPS_BITMAP_OP_OR || !oleaf) {
+                    continue;
+                }
+                key.dispatch = j;
+                w_deref_leaf(map, &dispatch, key, true);
+            } else
+            if (!oleaf) {
+                if (op == QPS_BITMAP_OP_AND) {
+                    delete_dispatch_leaf(map, dispatch, j);
+                } else {
+                    empty = false;
+                }
+                continue;
+            }
+            if (combine_leaf(map, dispatch, j, oleaf, other_nullable, op)) {
+                empty = false;
+            }
+        }
+
+        if (empty) {
+            qps_hptr_w_deref(map->qps, &map->root_cache);
+            qps_pg_unmap(map->qps, map->root->roots[i]);
+            map->root->roots[i] = 0;
+        }
+    }
+}
+
+void qps_bitmap_and(qps_bitmap_t *map, qps_bitmap_t *other)
+{
+    qps_bitmap_combine(map, other, QPS_BITMAP_OP_AND);
+}
+
+void qps_bitmap_or(qps_bitmap_t *map, qps_bitmap_t *other)
+{
+    qps_bitmap_combine(map, other, QPS_BITMAP_OP_OR);
+}
+
+void qps_bitmap_and_not(qps_bitmap_t *map, qps_bitmap_t *other)
+{
+    qps_bitmap_combine(map, other, QPS_BITMAP_OP_AND_NOT);
+}
+
+/* Counts the rows at 1 of a leaf in the range [from, to] of its rows. */
+static uint32_t leaf_count_range(const uint64_t *leaf, bool is_nullable,
+                                 uint32_t from, uint32_t to)
+{
+    unsigned w_first = from / 64;
+    unsigned w_last  = to / 64;
+    uint32_t count = 0;
+
+    for (unsigned w = w_first; w <= w_last; w++) {
+        uint64_t word = leaf_ones(leaf, is_nullable, w);
+
+        if (w == w_first) {
+            word &= UINT64_MAX << (from % 64);
+        }
+        if (w == w_last) {
+            word &= UINT64_MAX >> (63 - to % 64);
+        }
+        count += bitcount64(word);
+    }
+    return count;
+}
+
+uint64_t qps_bitmap_count_range(qps_bitmap_t *map, uint32_t first,
+                                uint32_t last)
+{
+    qps_bitmap_key_t kfirst = { .key = first };
+    qps_bitmap_key_t klast  = { .key = last };
+    uint64_t count = 0;
+    bool is_nullable;
+
+    if (first > last) {
+        return 0;
+    }
+    qps_hptr_deref(map->qps, &map->root_cache);
+    is_nullable = map->root->is_nullable;
+
+    for (unsigned i = kfirst.root; i <= klast.root; i++) {
+        const qps_bitmap_dispatch_t *dispatch;
+        unsigned j_first = i == kfirst.root ? kfirst.dispatch : 0;
+        unsigned j_last  = i == klast.root ? klast.dispatch
+                                           : QPS_BITMAP_DISPATCH - 1;
+
+        if (map->root->roots[i] == 0) {
+            continue;
+        }
+        dispatch = qps_pg_deref(map->qps, map->root->roots[i]);
+        for (unsigned j = j_first; j <= j_last; j++) {
+            qps_bitmap_key_t key = { .key = 0 };
+            uint32_t from, to;
+
+            if ((*dispatch)[j].node == 0) {
+                continue;
+            }
+            key.root     = i;
+            key.dispatch = j;
+            from = MAX(first, key.key) - key.key;
+            to   = MIN(last, key.key + QPS_BITMAP_LEAF - 1) - key.key;
+            if (!is_nullable && from == 0 && to == QPS_BITMAP_LEAF - 1) {
+                count += (*dispatch)[j].active_bits;
+            } else {
+                count += leaf_count_range(qps_pg_deref(map->qps,
+                                                       (*dispatch)[j].node),
+                                          is_nullable, from, to);
+            }
+        }
+    }
+    return count;
+}
+
+void qps_bitmap_to_wah(qps_bitmap_t *map, wah_t *wah)
+{
+    uint64_t words[QPS_BITMAP_WORD];
+    uint64_t len = 0;
+    bool is_nullable;
+
+    wah_reset_map(wah);
+    qps_hptr_deref(map->qps, &map->root_cache);
+    is_nullable = map->root->is_nullable;
+
+    for (unsigned i = 0; i < QPS_BITMAP_ROOTS; i++) {
+        const qps_bitmap_dispatch_t *dispatch;
+
+        if (map->root->roots[i] == 0) {
+            continue;
+        }
+        dispatch = qps_pg_deref(map->qps, map->root->roots[i]);
+        for (unsigned j = 0; j < QPS_BITMAP_DISPATCH; j++) {
+            qps_bitmap_key_t key = { .key = 0 };
+            const uint64_t *leaf;
+            uint64_t bits;
+            int last;
+
+            if ((*dispatch)[j].node == 0) {
+                continue;
+            }
+            leaf = qps_pg_deref(map->qps, (*dispatch)[j].node);
+            if (is_nullable) {
+                for (unsigned w = 0; w < QPS_BITMAP_WORD; w++) {
+                    words[w] = leaf_ones(leaf, true, w);
+                }
+                leaf = words;
+            }
+            last = QPS_BITMAP_WORD - 1;
+            while (last >= 0 && !leaf[last]) {
+                last--;
+            }
+            if (last < 0) {
+                continue;
+            }
+
+            /* the trailing 0s of the leaf are not appended */
+            key.root     = i;
+            key.dispatch = j;
+            bits = last * 64 + bsr64(leaf[last]) + 1;
+            wah_add0s(wah, key.key - len);
+            wah_add(wah, leaf, bits);
+            len = key.key + bits;
+        }
+    }
+}
+
+void qps_bitmap_from_wah(qps_bitmap_t *map, const wah_t *wah)
+{
+    wah_word_enum_t en = wah_word_enum_start(wah, false);
+    qps_bitmap_dispatch_t *dispatch = NULL;
+    uint64_t *leaf = NULL;
+    uint32_t leaf_no = 0;
+    uint64_t pos = 0;
+    bool is_nullable;
+
+    assert (wah->len <= UINT64_C(1) << 32);
+    qps_hptr_deref(map->qps, &map->root_cache);
+    is_nullable = map->root->is_nullable;
+    map->bitmap_gen++;
+
+    for (;;) {
+        qps_bitmap_key_t key;
+        uint32_t word;
+        uint32_t added;
+
+        pos += wah_word_enum_skip0(&en);
+        if (en.state == WAH_ENUM_END) {
+            break;
+        }
+        word = en.current;
+        if (wah->len - pos * WAH_BIT_IN_WORD < WAH_BIT_IN_WORD) {
+            /* pending word, ignore what is past the end of the WAH */
+            word &= BITMASK_LT(uint32_t, wah->len % WAH_BIT_IN_WORD);
+            if (!word) {
+                break;
+            }
+        }
+        key.key = pos * WAH_BIT_IN_WORD;
+        if (!leaf || leaf_no != key.key / QPS_BITMAP_LEAF) {
+            dispatch = w_deref_dispatch(map, key, true);
+            leaf     = w_deref_leaf(map, &dispatch, key, true);
+            leaf_no  = key.key / QPS_BITMAP_LEAF;
+        }
+
+        if (is_nullable) {
+            uint64_t rows = nullable_word_spread(word);
+
+            /* the rows which were NULL become active */
+            added = bitcount64(rows & ~(leaf[key.word_null] >> 1));
+            leaf[key.word_null] |= rows | (rows << 1);
+        } else {
+            uint64_t rows = (uint64_t)word << key.bit;
+
+            added = bitcount64(rows & ~leaf[key.word]);
+            leaf[key.word] |= rows;
+        }
+        (*dispatch)[key.dispatch].active_bits += added;
+
+        pos++;
+        if (!wah_word_enum_next(&en)) {
+            break;
+        }
+    }
+}
+
 /* }}} */
 /* Debugging tool {{{ */
 
@@ -1275,6 +1275,7 @@ void qhat_clear(qhat_t *hat)
 {
     qhat_node_const_memory_t root;
     bool do_stats = hat->do_stats;
+    bool readers = qhat_mutation_begin(hat);
 
     qps_hptr_w_deref(hat->qps, &hat->root_cache);
 
@@ -1301,6 +1302,7 @@ void qhat_clear(qhat_t *hat)
     if (do_stats) {
         qhat_compute_counts(hat, true);
     }
+    qhat_mutation_end(hat, readers);
 }
 
 void qhat_destroy(qhat_t *hat)
@@ -1369,6 +1371,116 @@ void qhat_unload(qhat_t *hat)
     }
 }
 
+/* Number of lookups interleaved by qhat_get_many(). */
+#define QHAT_GET_BATCH  16
+
+static const void *qhat_leaf_get(const qhat_t *hat, qhat_node_t node,
+                                 uint32_t key)
+{
+    qhat_node_const_memory_t memory = qhat_node_deref_(hat->qps, node);
+
+    if (node.compact) {
+        uint32_t pos = qhat_compact_lookup(memory.compact, 0, key);
+
+        if (pos >= memory.compact->count
+        ||  memory.compact->keys[pos] != key)
+        {
+            return NULL;
+        }
+#define CASE(Size, Compact, Flat)  return &Compact->values[pos]
+        QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+    }
+#define CASE(Size, Compact, Flat)  \
+    return &Flat[key & hat->desc->leaf_index_mask]
+    QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+}
+
+void qhat_get_many(qhat_t *hat, const uint32_t *rows, uint32_t count,
+                   const void **values)
+{
+    const qhat_desc_t *desc = hat->desc;
+    qps_t *qps = hat->qps;
+
+    qps_hptr_deref(qps, &hat->root_cache);
+
+    for (uint32_t from = 0; from < count; from += QHAT_GET_BATCH) {
+        qhat_node_t nodes[QHAT_GET_BATCH];
+        qps_bitmap_state_t states[QHAT_GET_BATCH];
+        const uint32_t *keys = rows + from;
+        uint32_t n = MIN(count - from, QHAT_GET_BATCH);
+
+        if (hat->bitmap.root) {
+            qps_bitmap_get_many(&hat->bitmap, keys, n, states);
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            nodes[i] = hat->root->nodes[qhat_get_key_bits(hat, keys[i], 0)];
+        }
+
+        /* Walk down the dispatch nodes one depth at a time for the whole
+         * batch: the slots of a depth are all prefetched before the first
+         * one is read. */
+        for (uint32_t depth = 1; depth < QHAT_DEPTH_MAX; depth++) {
+            const qhat_node_t *slots[QHAT_GET_BATCH];
+            bool found = false;
+
+            for (uint32_t i = 0; i < n; i++) {
+                if (nodes[i].value == 0 || nodes[i].leaf) {
+                    slots[i] = NULL;
+                    continue;
+                }
+                slots[i] = qhat_node_deref_(qps, nodes[i]).nodes
+                         + qhat_get_key_bits(hat, keys[i], depth);
+                __builtin_prefetch(slots[i]);
+                found = true;
+            }
+            if (!found) {
+                break;
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                if (slots[i]) {
+                    nodes[i] = *slots[i];
+                }
+            }
+        }
+
+        /* Prefetch the header of the compacts (the first keys probed by
+         * the lookup come next) and the value in the flats. */
+        for (uint32_t i = 0; i < n; i++) {
+            qhat_node_const_memory_t memory;
+
+            if (nodes[i].value == 0) {
+                continue;
+            }
+            memory = qhat_node_deref_(qps, nodes[i]);
+            if (nodes[i].compact) {
+                __builtin_prefetch(memory.compact);
+            } else {
+                __builtin_prefetch(memory.u8 + (keys[i] & desc->leaf_index_mask)
+                                   * desc->value_len);
+            }
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            const void *value = NULL;
+
+            if (hat->bitmap.root && !states[i]) {
+                values[from + i] = NULL;
+                continue;
+            }
+            if (nodes[i].value != 0) {
+                value = qhat_leaf_get(hat, nodes[i], keys[i]);
+            }
+            if (hat->bitmap.root && !value) {
+                value = &qhat_default_zero_g;
+            }
+            values[from + i] = value;
+        }
+    }
+}
+
 #define SIZE                    8
 #define PAGES_PER_FLAT          1
 #include "qps-hat.in.c"
@@ -1428,6 +1540,628 @@ void qhat_fix_stored0(qhat_t *hat)
     }
 }
 
+/* }}} */
+/* Bulk load {{{ */
+
+/* The loader keeps one level per depth of the trie. Each level buffers the
+ * keys of its current slot, preceded by the keys of the pending compact,
+ * that spans the slots [grp_left, slot) of the level. Once the current slot
+ * holds more keys than the split threshold, it cannot be part of a compact
+ * anymore: the pending compact is flushed and the slot becomes a dispatch
+ * node (whose keys are pushed to the next level) or a flat leaf at the
+ * last depth.
+ */
+
+enum {
+    QHAT_BULK_SLOT_KEYS,
+    QHAT_BULK_SLOT_NODE,
+    QHAT_BULK_SLOT_FLAT,
+};
+
+typedef struct qhat_bulk_level_t {
+    qhat_node_t node;
+    uint32_t    slot_count;
+
+    uint32_t    slot;
+    uint8_t     slot_kind;
+    qhat_node_memory_t flat;
+
+    uint32_t    grp_left;
+    uint32_t    grp_len;
+
+    uint32_t    len;
+    uint32_t   *keys;
+    uint8_t    *values;
+} qhat_bulk_level_t;
+
+struct qhat_bulk_loader_t {
+    qhat_t  *hat;
+    bool     has_last;
+    uint32_t last;
+
+    uint32_t compact_keys;
+    uint32_t flat_keys;
+    uint32_t flat_count;
+
+    qhat_bulk_level_t levels[QHAT_DEPTH_MAX];
+};
+
+static qhat_node_memory_t qhat_bulk_level_nodes(qhat_bulk_loader_t *bl,
+                                                int depth)
+{
+    qhat_t *hat = bl->hat;
+
+    if (depth == 0) {
+        qps_hptr_w_deref(hat->qps, &hat->root_cache);
+        return (qhat_node_memory_t){ .nodes = hat->root->nodes };
+    }
+    return qhat_node_w_deref_(hat->qps, bl->levels[depth].node);
+}
+
+static void *qhat_compact_values(const qhat_t *hat, qhat_node_memory_t memory)
+{
+#define CASE(Size, Compact, Flat)  return Compact->values
+    QHAT_VALUE_LEN_SWITCH(hat, memory, CASE);
+#undef CASE
+}
+
+/* Flush the pending compact of a level, spanning up to the slot `right`. */
+static void qhat_bulk_flush_compact(qhat_bulk_loader_t *bl, int depth,
+                                    uint32_t right)
+{
+    qhat_t *hat = bl->hat;
+    qhat_bulk_level_t *lvl = &bl->levels[depth];
+    qhat_node_memory_t memory;
+    qhat_node_memory_t parent;
+    qhat_node_t node;
+
+    if (lvl->grp_len == 0) {
+        return;
+    }
+
+    node = qhat_alloc_leaf(hat, true);
+    memory = qhat_node_w_deref_(hat->qps, node);
+    memory.compact->count        = lvl->grp_len;
+    memory.compact->parent_left  = lvl->grp_left;
+    memory.compact->parent_right = right;
+    p_copy(memory.compact->keys, lvl->keys, lvl->grp_len);
+    memcpy(qhat_compact_values(hat, memory), lvl->values,
+           lvl->grp_len * hat->desc->value_len);
+
+    parent = qhat_bulk_level_nodes(bl, depth);
+    for (uint32_t i = lvl->grp_left; i < right; i++) {
+        parent.nodes[i] = node;
+    }
+    bl->compact_keys += lvl->grp_len;
+    lvl->grp_len = 0;
+}
+
+static void qhat_bulk_push(qhat_bulk_loader_t *bl, int depth, uint32_t key,
+                           const void *value);
+static void qhat_bulk_finish_level(qhat_bulk_loader_t *bl, int depth);
+
+/* The current slot of the level holds too many keys for a compact. */
+static void qhat_bulk_split_slot(qhat_bulk_loader_t *bl, int depth)
+{
+    qhat_t *hat = bl->hat;
+    qhat_bulk_level_t *lvl = &bl->levels[depth];
+    uint32_t value_len = hat->desc->value_len;
+    uint32_t from = lvl->grp_len;
+    qhat_node_memory_t parent;
+    qhat_node_t node;
+
+    qhat_bulk_flush_compact(bl, depth, lvl->slot);
+
+    if (depth == QHAT_DEPTH_MAX - 1) {
+        node = qhat_alloc_leaf(hat, false);
+        lvl->flat = qhat_node_w_deref_(hat->qps, node);
+        lvl->slot_kind = QHAT_BULK_SLOT_FLAT;
+        bl->flat_count++;
+    } else {
+        qhat_bulk_level_t *child = &bl->levels[depth + 1];
+
+        node = qhat_alloc_node(hat);
+        qps_pg_zero(hat->qps, node.page, 1);
+        lvl->slot_kind = QHAT_BULK_SLOT_NODE;
+
+        child->node       = node;
+        child->slot_count = QHAT_COUNT;
+        child->slot       = 0;
+        child->slot_kind  = QHAT_BULK_SLOT_KEYS;
+        child->grp_left   = 0;
+        child->grp_len    = 0;
+        child->len        = 0;
+    }
+    parent = qhat_bulk_level_nodes(bl, depth);
+    parent.nodes[lvl->slot] = node;
+
+    for (uint32_t i = from; i < lvl->len; i++) {
+        qhat_bulk_push(bl, depth, lvl->keys[i], lvl->values + i * value_len);
+    }
+    lvl->len = 0;
+}
+
+/* Close the current slot of a level and move to the slot `next`. */
+static void qhat_bulk_close_slot(qhat_bulk_loader_t *bl, int depth,
+                                 uint32_t next)
+{
+    qhat_bulk_level_t *lvl = &bl->levels[depth];
+    uint32_t value_len = bl->hat->desc->value_len;
+    uint32_t slot_len = lvl->len - lvl->grp_len;
+    uint32_t slot_start = lvl->grp_len;
+
+    switch (lvl->slot_kind) {
+      case QHAT_BULK_SLOT_NODE:
+        qhat_bulk_finish_level(bl, depth + 1);
+        /* FALLTHROUGH */
+
+      case QHAT_BULK_SLOT_FLAT:
+        lvl->grp_left = lvl->slot + 1;
+        break;
+
+      default:
+        if (lvl->len > bl->hat->desc->split_compact_threshold) {
+            /* The slot starts a new compact, the pending one spans the
+             * empty slots up to it. */
+            qhat_bulk_flush_compact(bl, depth, lvl->slot);
+            p_move(lvl->keys, lvl->keys + slot_start, slot_len);
+            memmove(lvl->values, lvl->values + slot_start * value_len,
+                    slot_len * value_len);
+            lvl->grp_left = lvl->slot;
+            lvl->len = slot_len;
+        }
+        lvl->grp_len = lvl->len;
+        break;
+    }
+    lvl->slot = next;
+    lvl->slot_kind = QHAT_BULK_SLOT_KEYS;
+}
+
+static void qhat_bulk_finish_level(qhat_bulk_loader_t *bl, int depth)
+{
+    qhat_bulk_level_t *lvl = &bl->levels[depth];
+
+    qhat_bulk_close_slot(bl, depth, lvl->slot_count);
+    qhat_bulk_flush_compact(bl, depth, lvl->slot_count);
+    lvl->len = 0;
+}
+
+static void qhat_bulk_push(qhat_bulk_loader_t *bl, int depth, uint32_t key,
+                           const void *value)
+{
+    const qhat_desc_t *desc = bl->hat->desc;
+
+    for (;; depth++) {
+        qhat_bulk_level_t *lvl = &bl->levels[depth];
+        uint32_t slot = qhat_get_key_bits(bl->hat, key, depth);
+
+        if (slot != lvl->slot) {
+            qhat_bulk_close_slot(bl, depth, slot);
+        }
+
+        switch (lvl->slot_kind) {
+          case QHAT_BULK_SLOT_NODE:
+            continue;
+
+          case QHAT_BULK_SLOT_FLAT:
+            memcpy(lvl->flat.u8 + (key & desc->leaf_index_mask)
+                                * desc->value_len, value, desc->value_len);
+            bl->flat_keys++;
+            return;
+
+          default:
+            lvl->keys[lvl->len] = key;
+            memcpy(lvl->values + lvl->len * desc->value_len, value,
+                   desc->value_len);
+            lvl->len++;
+            if (lvl->len - lvl->grp_len > desc->split_compact_threshold) {
+                qhat_bulk_split_slot(bl, depth);
+            }
+            return;
+        }
+    }
+}
+
+qhat_bulk_loader_t *qhat_bulk_load_start(qhat_t *hat)
+{
+    const qhat_desc_t *desc = hat->desc;
+    qhat_bulk_loader_t *bl;
+
+    qps_hptr_w_deref(hat->qps, &hat->root_cache);
+    if (!is_memory_zero(hat->root->nodes, sizeof(hat->root->nodes))) {
+        logger_panic(&hat->qps->logger, "cannot bulk load a non-empty trie");
+    }
+
+    bl = p_new(qhat_bulk_loader_t, 1);
+    bl->hat = hat;
+    for (int i = 0; i < QHAT_DEPTH_MAX; i++) {
+        /* At most a full pending compact and a slot above the threshold. */
+        uint32_t size = 2 * desc->split_compact_threshold + 1;
+
+        bl->levels[i].keys   = p_new_raw(uint32_t, size);
+        bl->levels[i].values = p_new_raw(uint8_t, size * desc->value_len);
+    }
+    bl->levels[0].slot_count = desc->root_node_count;
+    return bl;
+}
+
+void qhat_bulk_load_add(qhat_bulk_loader_t *bl, const uint32_t *rows,
+                        const void *values, uint32_t count)
+{
+    qhat_t *hat = bl->hat;
+    uint32_t value_len = hat->desc->value_len;
+    const uint8_t *value = values;
+    bool readers = qhat_mutation_begin(hat);
+
+    qps_hptr_w_deref(hat->qps, &hat->root_cache);
+    for (uint32_t i = 0; i < count; i++, value += value_len) {
+        uint32_t row = rows[i];
+
+        if (unlikely(bl->has_last && row <= bl->last)) {
+            logger_panic(&hat->qps->logger,
+                         "bulk load rows are not sorted: %u after %u",
+                         row, bl->last);
+        }
+        bl->has_last = true;
+        bl->last = row;
+
+        if (hat->bitmap.root) {
+            qps_bitmap_set(&hat->bitmap, row);
+        }
+        if (!is_memory_zero(value, value_len)) {
+            qhat_bulk_push(bl, 0, row, value);
+        }
+    }
+    qhat_mutation_end(hat, readers);
+}
+
+void qhat_bulk_load_finish(qhat_bulk_loader_t **blp)
+{
+    qhat_bulk_loader_t *bl = *blp;
+    qhat_t *hat;
+    bool readers;
+
+    if (!bl) {
+        return;
+    }
+    hat = bl->hat;
+    readers = qhat_mutation_begin(hat);
+
+    qps_hptr_w_deref(hat->qps, &hat->root_cache);
+    qhat_bulk_finish_level(bl, 0);
+    if (hat->do_stats) {
+        hat->root->entry_count       += bl->compact_keys + bl->flat_keys;
+        hat->root->key_stored_count  += bl->compact_keys;
+        hat->root->zero_stored_count += bl->flat_count
+                                      * hat->desc->leaves_per_flat
+                                      - bl->flat_keys;
+    }
+    hat->gen.s.struct_gen++;
+#ifndef NDEBUG
+    hat->gen.s.write_access_gen++;
+#endif
+    qhat_mutation_end(hat, readers);
+    CHECK_CONSISTENCY(hat);
+
+    for (int i = 0; i < QHAT_DEPTH_MAX; i++) {
+        p_delete(&bl->levels[i].keys);
+        p_delete(&bl->levels[i].values);
+    }
+    p_delete(blp);
+}
+
+void qhat_bulk_load(qhat_t *hat, const uint32_t *rows, const void *values,
+                    uint32_t count)
+{
+    qhat_bulk_loader_t *bl = qhat_bulk_load_start(hat);
+
+    qhat_bulk_load_add(bl, rows, values, count);
+    qhat_bulk_load_finish(&bl);
+}
+
+/* }}} */
+/* Concurrent readers {{{ */
+
+/* The readers run while the writer modifies the trie: the pages they reach
+ * can be any page of the qps, in any state. The pages are checked before
+ * being read, the counts are bounded, and the result is only used if the
+ * write sequence did not change meanwhile.
+ */
+
+static ALWAYS_INLINE uint32_t qhat_read_once(const uint32_t *ptr)
+{
+    return atomic_load_explicit(cast(atomic_uint32_t *, ptr),
+                                memory_order_relaxed);
+}
+
+static uint32_t qhat_reader_seq_begin(qhat_t *hat)
+{
+    uint32_t seq;
+
+    while ((seq = atomic_load_explicit(&hat->write_seq,
+                                       memory_order_acquire)) & 1)
+    {
+        cpu_relax();
+    }
+    return seq;
+}
+
+static bool qhat_reader_seq_retry(qhat_t *hat, uint32_t seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&hat->write_seq, memory_order_relaxed) != seq;
+}
+
+static const qhat_root_t *qhat_reader_root(const qhat_t *hat)
+{
+    return qps_handle_reader_deref(hat->qps, hat->root_cache.handle);
+}
+
+static qhat_node_memory_t qhat_reader_deref(const qhat_t *hat,
+                                            qhat_node_t node, size_t pages)
+{
+    return (qhat_node_memory_t){
+        .raw = cast(void *, qps_pg_reader_deref(hat->qps, node.page, pages)),
+    };
+}
+
+static const void *qhat_reader_leaf_get(const qhat_t *hat, qhat_node_t node,
+                                        uint32_t key)
+{
+    const qhat_desc_t *desc = hat->desc;
+    qhat_node_memory_t memory;
+
+    if (node.compact) {
+        uint32_t count;
+        size_t   pos;
+        bool     found;
+
+        memory = qhat_reader_deref(hat, node, desc->pages_per_compact);
+        if (!memory.raw) {
+            return NULL;
+        }
+        count = MIN(qhat_read_once(&memory.compact->count),
+                    desc->leaves_per_compact);
+        pos = bisect32(key, memory.compact->keys, count, &found);
+        if (!found) {
+            return NULL;
+        }
+        return (const uint8_t *)qhat_compact_values(hat, memory)
+             + pos * desc->value_len;
+    }
+
+    memory = qhat_reader_deref(hat, node, desc->pages_per_flat);
+    if (!memory.raw) {
+        return NULL;
+    }
+    return memory.u8 + (key & desc->leaf_index_mask) * desc->value_len;
+}
+
+static const void *qhat_reader_lookup(const qhat_t *hat,
+                                      const qhat_root_t *root, uint32_t key)
+{
+    qhat_node_t node;
+
+    node.value = qhat_read_once(&root->nodes[qhat_get_key_bits(hat, key,
+                                                               0)].value);
+    for (uint32_t depth = 1; node.value && !node.leaf; depth++) {
+        qhat_node_memory_t memory;
+
+        if (depth >= QHAT_DEPTH_MAX) {
+            return NULL;
+        }
+        memory = qhat_reader_deref(hat, node, 1);
+        if (!memory.raw) {
+            return NULL;
+        }
+        node.value = qhat_read_once(&memory.nodes[qhat_get_key_bits(hat, key,
+                                                                     depth)].value);
+    }
+    return node.value ? qhat_reader_leaf_get(hat, node, key) : NULL;
+}
+
+bool qhat_reader_get(qhat_t *hat, uint32_t row, void *value)
+{
+    const qhat_desc_t *desc = hat->desc;
+    qps_handle_t bitmap = hat->bitmap.root_cache.handle;
+    bool res;
+
+    qps_reader_enter(hat->qps);
+    do {
+        uint32_t seq = qhat_reader_seq_begin(hat);
+        const qhat_root_t *root = qhat_reader_root(hat);
+        const void *src = root ? qhat_reader_lookup(hat, root, row) : NULL;
+
+        if (src) {
+            memcpy(value, src, desc->value_len);
+        } else {
+            memset(value, 0, desc->value_len);
+        }
+        if (bitmap) {
+            res = qps_bitmap_reader_get(hat->qps, bitmap, row)
+                != QPS_BITMAP_0;
+        } else {
+            res = memcmp(value, &qhat_default_zero_g, desc->value_len) != 0;
+        }
+        if (!qhat_reader_seq_retry(hat, seq)) {
+            break;
+        }
+    } while (true);
+    qps_reader_leave(hat->qps);
+
+    return res;
+}
+
+typedef struct qhat_reader_fetch_t {
+    qhat_t   *hat;
+    uint32_t  from;
+    uint32_t  count;
+    uint32_t  max;
+    uint32_t *rows;
+    uint8_t  *values;
+} qhat_reader_fetch_t;
+
+/* Returns false once the fetch is full. */
+static bool qhat_reader_fetch_value(qhat_reader_fetch_t *fetch, uint32_t key,
+                                    const uint8_t *value)
+{
+    uint8_t  len = fetch->hat->desc->value_len;
+    uint8_t *dst = fetch->values + fetch->count * len;
+
+    memcpy(dst, value, len);
+    if (memcmp(dst, &qhat_default_zero_g, len) != 0) {
+        fetch->rows[fetch->count++] = key;
+    }
+    return fetch->count < fetch->max;
+}
+
+/* Fetches the keys of a leaf in [first, last]. */
+static bool qhat_reader_fetch_leaf(qhat_reader_fetch_t *fetch,
+                                   qhat_node_t node, uint32_t first,
+                                   uint32_t last)
+{
+    const qhat_t *hat = fetch->hat;
+    const qhat_desc_t *desc = hat->desc;
+    qhat_node_memory_t memory;
+
+    first = MAX(first, fetch->from);
+    if (node.compact) {
+        const uint8_t *values;
+        uint32_t count;
+
+        memory = qhat_reader_deref(hat, node, desc->pages_per_compact);
+        if (!memory.raw) {
+            return false;
+        }
+        count = MIN(qhat_read_once(&memory.compact->count),
+                    desc->leaves_per_compact);
+        values = qhat_compact_values(hat, memory);
+        for (uint32_t pos = bisect32(first, memory.compact->keys, count, NULL);
+             pos < count; pos++)
+        {
+            uint32_t key = qhat_read_once(&memory.compact->keys[pos]);
+
+            if (key > last) {
+                break;
+            }
+            if (key >= first
+            &&  !qhat_reader_fetch_value(fetch, key,
+                                         values + pos * desc->value_len))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    memory = qhat_reader_deref(hat, node, desc->pages_per_flat);
+    if (!memory.raw) {
+        return false;
+    }
+    for (uint64_t key = first; key <= last; key++) {
+        const uint8_t *value;
+
+        value = memory.u8 + (key & desc->leaf_index_mask) * desc->value_len;
+        if (!qhat_reader_fetch_value(fetch, key, value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Fetches the keys of the slots of a dispatch node (or of the root), the
+ * first slot starting at the key `prefix`. */
+static bool qhat_reader_fetch_nodes(qhat_reader_fetch_t *fetch,
+                                    const qhat_node_t *nodes, uint32_t count,
+                                    uint32_t depth, uint64_t prefix)
+{
+    const qhat_t *hat = fetch->hat;
+    uint32_t shift = qhat_depth_shift(hat, depth);
+    uint64_t span  = 1ULL << shift;
+    uint32_t start = 0;
+
+    if (fetch->from > prefix) {
+        start = MIN((fetch->from - prefix) >> shift, count);
+    }
+    for (uint32_t i = start; i < count; i++) {
+        qhat_node_t node = { .value = qhat_read_once(&nodes[i].value) };
+        uint64_t first = prefix + i * span;
+
+        if (node.value == 0) {
+            continue;
+        }
+        if (node.leaf) {
+            uint32_t end = i + 1;
+
+            /* a compact spans all the consecutive slots pointing to it */
+            while (node.compact && end < count
+               &&  qhat_read_once(&nodes[end].value) == node.value)
+            {
+                end++;
+            }
+            if (!qhat_reader_fetch_leaf(fetch, node, first,
+                                        prefix + end * span - 1))
+            {
+                return false;
+            }
+            i = end - 1;
+        } else {
+            qhat_node_memory_t memory;
+
+            if (depth + 1 >= QHAT_DEPTH_MAX) {
+                return false;
+            }
+            memory = qhat_reader_deref(hat, node, 1);
+            if (!memory.raw
+            ||  !qhat_reader_fetch_nodes(fetch, memory.nodes, QHAT_COUNT,
+                                         depth + 1, first))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t qhat_reader_fetch(qhat_t *hat, uint64_t *from, uint32_t *rows,
+                           void *values, uint32_t max)
+{
+    qhat_reader_fetch_t fetch = {
+        .hat    = hat,
+        .max    = max,
+        .rows   = rows,
+        .values = values,
+    };
+
+    if (*from > UINT32_MAX || max == 0) {
+        return 0;
+    }
+    fetch.from = *from;
+
+    qps_reader_enter(hat->qps);
+    do {
+        uint32_t seq = qhat_reader_seq_begin(hat);
+        const qhat_root_t *root = qhat_reader_root(hat);
+
+        fetch.count = 0;
+        if (root) {
+            qhat_reader_fetch_nodes(&fetch, root->nodes,
+                                    hat->desc->root_node_count, 0, 0);
+        }
+        if (!qhat_reader_seq_retry(hat, seq)) {
+            break;
+        }
+    } while (true);
+    qps_reader_leave(hat->qps);
+
+    if (fetch.count == max) {
+        *from = (uint64_t)rows[max - 1] + 1;
+    } else {
+        *from = (uint64_t)UINT32_MAX + 1;
+    }
+    return fetch.count;
+}
+
 /* }}} */
 /* Enumerator {{{ */
 
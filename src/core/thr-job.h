@@ -23,6 +23,7 @@
 
 #include <lib-common/unix.h>
 
+/** Initial capacity of the job deque of each thread, it grows as needed. */
 #define THR_JOB_MAX   256
 
 typedef struct thr_job_t   thr_job_t;
@@ -118,8 +119,8 @@ size_t thr_id(void) __leaf __attribute__((pure));
  *
  * The job life-cycle is the responsibility of the caller.
  *
- * Note that each thread can only queue up to a fixed number of jobs. Any job
- * in excess is run immediately instead of being queued.
+ * The deque of a thread starts with room for THR_JOB_MAX jobs, and grows
+ * when it is full.
  *
  * In the fast paths, job queuing and dequeuing are very fast (below 40-50
  * cycles probably). Stealing a job in the fast path is pretty fast too,
@@ -146,6 +147,49 @@ static ALWAYS_INLINE void thr_syn_schedule_b(thr_syn_t *syn, block_t blk)
 thr_queue_t *thr_queue_create(void) __leaf;
 void thr_queue_destroy(thr_queue_t *q, bool wait) __leaf;
 
+/** \brief Create a serial queue whose jobs preferably run on a NUMA node.
+ *
+ * When they are queued from a thread of another node, the jobs of the queue
+ * are handed to the threads of \p node, which are only expected to be there
+ * when the threads are pinned (see \ref thr_job_set_cpu_pinning). They may
+ * still run on another node when all the threads of \p node are busy.
+ *
+ * \param[in] node  the NUMA node, a node that does not exist (or an unknown
+ *                  topology) gives a regular queue.
+ */
+thr_queue_t *thr_queue_create_on_node(int node) __leaf;
+
+/** Priority of a serial queue, used when it is waiting for a thread. */
+typedef enum thr_queue_prio_t {
+    THR_QUEUE_PRIO_LOW,
+    THR_QUEUE_PRIO_NORMAL,
+    THR_QUEUE_PRIO_HIGH,
+} thr_queue_prio_t;
+
+/** \brief Create a serial queue with a priority.
+ *
+ * The runnable high priority queues are run before any other job, though a
+ * thread still runs one of its own jobs every few high priority queues so
+ * that nothing starves. Their jobs should rather be short, such as answering
+ * a query while a batch processing is running.
+ *
+ * The runnable low priority queues are run when the threads are idle, or
+ * when they have been waiting for more than 100ms.
+ *
+ * The priority applies to the queue as a whole, when it waits for a thread:
+ * once it runs, the queue is drained regardless of the others. It takes
+ * precedence over the NUMA node of the queue.
+ *
+ * \param[in] prio  THR_QUEUE_PRIO_NORMAL gives a regular queue.
+ */
+thr_queue_t *thr_queue_create_prio(thr_queue_prio_t prio) __leaf;
+
+/** \brief returns the NUMA node of the current thread, -1 if unknown. */
+int thr_numa_node(void) __leaf;
+
+/** \brief returns the number of NUMA nodes, 0 if the topology is unknown. */
+int thr_numa_nodes_count(void) __leaf;
+
 /** Return true if the queue is currently running on the current thread.
  *
  * This basically means we are inside the queue.
@@ -335,6 +379,22 @@ void thr_queue_main_drain(void);
  */
 bool thr_job_reload_at_fork(bool enabled);
 
+/** \brief enable/disable the pinning of the threads on the CPUs.
+ *
+ * When enabled, each thread but the main one is pinned on one of the CPUs
+ * the process is allowed to run on. This only applies to the threads
+ * started afterwards, so it should be called before the thr module is
+ * initialized. It can also be enabled with the THR_CPU_PINNING environment
+ * variable.
+ *
+ * Whether pinned or not, the threads steal jobs from the closest threads
+ * first: the ones on SMT siblings, then the ones sharing the last level
+ * cache, then the ones on the same NUMA node, as read from sysfs.
+ *
+ * \return Previous state of the pinning.
+ */
+bool thr_job_set_cpu_pinning(bool enabled);
+
 /** \brief fork() preserving threads-jobs */
 __must_check__
 static inline pid_t thr_job_fork(void)
@@ -370,16 +430,162 @@ void thr_exit_blocking_syscall(void);
  */
 void thr_for_each(size_t count, void (BLOCK_CARET blk)(size_t pos));
 
+/** Run jobs on the chunks of the range [\p begin, \p end[.
+ *
+ * The range is cut in chunks of \p grain positions, and \p blk is called
+ * once per chunk with its bounds. The chunks are scheduled by recursively
+ * splitting the range in halves, so that idle threads steal large parts of
+ * it. This is a lot cheaper than \ref thr_for_each when the work done per
+ * position is small.
+ *
+ * The function exits when all the chunks have been processed.
+ *
+ * \param[in] grain  number of positions per chunk, 0 to pick one giving
+ *                   about 8 chunks per thread.
+ */
+void thr_for_range(size_t begin, size_t end, size_t grain,
+                   void (BLOCK_CARET nonnull blk)(size_t from, size_t to));
+
+/** Parallel reduction on the range [\p begin, \p end[.
+ *
+ * The range is processed as in \ref thr_for_range, each chunk being
+ * accumulated by \p blk in a thread data (see \ref thr_syn_declare_td)
+ * that no other job uses meanwhile. Once all the chunks have been
+ * processed, \p merge is called on every thread data, in the calling
+ * thread, before they are deleted.
+ *
+ * \param[in] new_td     allocator of the thread data (accumulators).
+ * \param[in] delete_td  deallocator of the thread data.
+ * \param[in] blk        accumulates the positions [from, to[ in \p td.
+ * \param[in] merge      merges an accumulator in the final result.
+ */
+void thr_reduce(size_t begin, size_t end, size_t grain,
+                thr_td_t * nonnull (BLOCK_CARET nonnull new_td)(void),
+                void (BLOCK_CARET nonnull delete_td)(thr_td_t * nullable * nonnull),
+                void (BLOCK_CARET nonnull blk)(thr_td_t * nonnull td,
+                                               size_t from, size_t to),
+                void (BLOCK_CARET nonnull merge)(const thr_td_t * nonnull td));
+
 #endif
 
+/*- futures --------------------------------------------------------------*/
+
+/** Result of an asynchronous computation.
+ *
+ * A future is computed by a job, possibly on a serial queue, and other
+ * futures can be chained to it so that pipelines of jobs run without
+ * blocking any thread. Use thr_queue_main_g to get a result back in the
+ * main thread (from the event loop).
+ *
+ * \code
+ * thr_future_t *unpacked = thr_future_async(NULL, ^void *(void) {
+ *     return unpack(query);
+ * });
+ * thr_future_t *answer = thr_future_then(unpacked, NULL, ^void *(void *q) {
+ *     return compute(q);
+ * });
+ * thr_future_t *reply = thr_future_then(answer, thr_queue_main_g,
+ *                                       ^void *(void *a) {
+ *     reply(a);
+ *     return NULL;
+ * });
+ *
+ * thr_future_release(&unpacked);
+ * thr_future_release(&answer);
+ * thr_future_release(&reply);
+ * \endcode
+ *
+ * The futures are reference counted: every function that returns one gives
+ * a reference to the caller, that must release it with thr_future_release()
+ * once it does not need its value anymore. The computation of a future
+ * holds its own references, so releasing a future does not cancel it.
+ */
+typedef struct thr_future_t thr_future_t;
+
+thr_future_t * nonnull thr_future_retain(thr_future_t * nonnull f);
+void thr_future_release(thr_future_t * nullable * nonnull f);
+
+#ifdef __has_blocks
+
+/** \brief Compute a future with \p blk.
+ *
+ * \param[in] q  the serial queue where \p blk runs, NULL for any thread.
+ */
+thr_future_t * nonnull
+thr_future_async(thr_queue_t * nullable q,
+                 void * nullable (BLOCK_CARET nonnull blk)(void));
+
+/** \brief Compute a future with \p blk once \p f is done.
+ *
+ * \p blk gets the value of \p f.
+ *
+ * \param[in] q  the serial queue where \p blk runs, NULL for any thread.
+ */
+thr_future_t * nonnull
+thr_future_then(thr_future_t * nonnull f, thr_queue_t * nullable q,
+                void * nullable (BLOCK_CARET nonnull blk)(void * nullable value));
+
+#endif
+
+/** \brief Get a future that is done once all the \p futures are.
+ *
+ * Its value is NULL, the values of the \p futures are read with
+ * thr_future_get().
+ */
+thr_future_t * nonnull
+thr_future_when_all(thr_future_t * nonnull * nonnull futures, int count);
+
+bool thr_future_is_done(thr_future_t * nonnull f);
+
+/** \brief Get the value of a future that is done. */
+void * nullable thr_future_get(thr_future_t * nonnull f);
+
+/** \brief Wait for a future and get its value.
+ *
+ * It blocks the thread, so it is meant to be used outside the jobs, a job
+ * should chain the work with thr_future_then() instead. A future can only
+ * be waited for by one thread at a time.
+ */
+void * nullable thr_future_wait(thr_future_t * nonnull f);
+
 /*- accounting -----------------------------------------------------------*/
 
-#if !defined(NDEBUG) && !defined(__has_tsan)
+/** Accounting of a thread of the pool.
+ *
+ * The counters are always maintained, they only cost a relaxed store in the
+ * hot paths. They are monotonic, from the start of the thread.
+ */
+typedef struct thr_worker_stats_t {
+    int      id;            /* see thr_id() */
+
+    uint64_t jobs_queued;   /* jobs pushed in the deque of the thread */
+    uint64_t jobs_run;
+    /* The steal success rate is steals / (steals + failed_steals +
+     * steal_misses). */
+    uint64_t steals;        /* jobs stolen from other threads */
+    uint64_t failed_steals; /* jobs stolen first by another thread */
+    uint64_t steal_misses;  /* searches that found no job at all */
+    uint64_t idle_ns;       /* time spent waiting for jobs */
+
+    /** Number of jobs in the deque of the thread, sampled when the stats are
+     * read. */
+    unsigned queue_depth;
+} thr_worker_stats_t;
+
+/** \brief Get the accounting of the threads of the pool.
+ *
+ * \param[out] stats  filled with the accounting of the first \p size
+ *                     threads.
+ * \return the number of threads, which may be larger than \p size.
+ */
+int thr_get_worker_stats(thr_worker_stats_t *stats, int size);
+
+/** \brief Log the accounting of the threads since the last thr_acc_reset().
+ *
+ * The cycle-level accounting (time in jobs, overhead, ...) is only
+ * available in debug builds.
+ */
 void thr_acc_reset(void);
 void thr_acc_trace(int lvl, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
-#else
-#define thr_acc_reset()            ((void)0)
-#define thr_acc_trace(...)         ((void)0)
-#endif
 
 #endif
@@ -0,0 +1,196 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/thr.h>
+
+mpmc_queue_t *mpmc_queue_new(size_t capacity)
+{
+    mpmc_queue_t *q;
+
+    capacity = MAX(capacity, 2);
+    if (capacity & (capacity - 1)) {
+        capacity = (size_t)1 << (bsrsz(capacity) + 1);
+    }
+
+    q = p_new_extra_field(mpmc_queue_t, cells, capacity);
+    q->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&q->cells[i].seq, i);
+    }
+    thr_ec_init(&q->not_empty);
+    thr_ec_init(&q->not_full);
+    return q;
+}
+
+void mpmc_queue_delete(mpmc_queue_t **qp)
+{
+    mpmc_queue_t *q = *qp;
+
+    if (q) {
+        thr_ec_wipe(&q->not_empty);
+        thr_ec_wipe(&q->not_full);
+        p_delete(qp);
+    }
+}
+
+/* {{{ Batches */
+
+/* The cells are claimed at once by moving 'tail' (resp. 'head') past them.
+ * The positions that are before 'head' (resp. 'tail') in the previous lap
+ * were claimed by consumers (resp. producers), so the cells are released
+ * shortly, unless the thread owning them is preempted.
+ */
+static void mpmc_cell_wait(mpmc_cell_t *cell, size_t seq)
+{
+    while (atomic_load_explicit(&cell->seq, memory_order_acquire) != seq) {
+        cpu_relax();
+    }
+}
+
+size_t mpmc_queue_push_n(mpmc_queue_t *q, void * const *v, size_t n)
+{
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t nb;
+
+    for (;;) {
+        size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+        if (unlikely((ssize_t)(pos - head) < 0)) {
+            /* outdated 'tail' */
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+            continue;
+        }
+        nb = MIN(n, q->mask + 1 - MIN(pos - head, q->mask + 1));
+        if (!nb) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + nb,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < nb; i++) {
+        mpmc_cell_t *cell = &q->cells[(pos + i) & q->mask];
+
+        mpmc_cell_wait(cell, pos + i);
+        cell->value = v[i];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+    mpmc_queue_wake(&q->pop_waiters, &q->not_empty, nb);
+    return nb;
+}
+
+size_t mpmc_queue_pop_n(mpmc_queue_t *q, void **v, size_t n)
+{
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t nb;
+
+    for (;;) {
+        size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+        /* 'pos' is never ahead of 'tail', even when outdated */
+        nb = MIN(n, tail - pos);
+        if (!nb) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + nb,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < nb; i++) {
+        mpmc_cell_t *cell = &q->cells[(pos + i) & q->mask];
+
+        mpmc_cell_wait(cell, pos + i + 1);
+        v[i] = cell->value;
+        atomic_store_explicit(&cell->seq, pos + i + q->mask + 1,
+                              memory_order_release);
+    }
+    mpmc_queue_wake(&q->push_waiters, &q->not_full, nb);
+    return nb;
+}
+
+/* }}} */
+/* {{{ Blocking */
+
+/* A waiter registers itself before it gets the key and checks the queue
+ * again, see mpmc_queue_wake().
+ */
+#define MPMC_WAIT(q, waiters, ec, cond)  ({                                  \
+        typeof(q) __q = (q);                                                 \
+        bool __ok;                                                           \
+                                                                             \
+        while (!(__ok = (cond))) {                                           \
+            uint64_t __key;                                                  \
+                                                                             \
+            atomic_fetch_add(&__q->waiters, 1);                              \
+            __key = thr_ec_get(&__q->ec);                                    \
+            if ((__ok = (cond))) {                                           \
+                atomic_fetch_sub(&__q->waiters, 1);                          \
+                break;                                                       \
+            }                                                                \
+            thr_ec_wait(&__q->ec, __key);                                    \
+            atomic_fetch_sub(&__q->waiters, 1);                              \
+        }                                                                    \
+    })
+
+void mpmc_queue_push_wait(mpmc_queue_t *q, void *v)
+{
+    MPMC_WAIT(q, push_waiters, not_full, mpmc_queue_push(q, v));
+}
+
+void mpmc_queue_push_n_wait(mpmc_queue_t *q, void * const *v, size_t n)
+{
+    while (n) {
+        size_t nb = 0;
+
+        MPMC_WAIT(q, push_waiters, not_full,
+                  (nb = mpmc_queue_push_n(q, v, n)) > 0);
+        v += nb;
+        n -= nb;
+    }
+}
+
+void *mpmc_queue_pop_wait(mpmc_queue_t *q)
+{
+    void *v;
+
+    MPMC_WAIT(q, pop_waiters, not_empty, mpmc_queue_pop(q, &v));
+    return v;
+}
+
+size_t mpmc_queue_pop_n_wait(mpmc_queue_t *q, void **v, size_t n)
+{
+    size_t nb = 0;
+
+    if (!n) {
+        return 0;
+    }
+    MPMC_WAIT(q, pop_waiters, not_empty, (nb = mpmc_queue_pop_n(q, v, n)) > 0);
+    return nb;
+}
+
+#undef MPMC_WAIT
+
+/* }}} */
@@ -0,0 +1,198 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#if !defined(IS_LIB_COMMON_THR_H) || defined(IS_LIB_COMMON_THR_MPMC_H)
+#  error "you must include thr.h instead"
+#else
+#define IS_LIB_COMMON_THR_MPMC_H
+
+#if !defined(__x86_64__) && !defined(__i386__)
+#  error "this file assumes a strict memory model and is probably buggy on !x86"
+#endif
+
+/*
+ * This file provides an implementation of a bounded MPMC queue of pointers.
+ *
+ * MPMC stands for Multiple-Producer, Multiple-Consumer.
+ *
+ * - bounded: the queue is a ring of a fixed capacity, and never allocates
+ *   after its creation. Pushing in a full queue fails (or blocks).
+ * - lock free: the single push and pop only involve one CAS in the fast
+ *   path. The batch versions claim all their cells at once, and then wait
+ *   for the threads that claimed them before (if any) to release them.
+ * - non blocking: the base functions return false instead of blocking, the
+ *   _wait versions sleep on an eventcount.
+ *
+ * Every cell holds a sequence number telling whether it can be written by
+ * the producer or read by the consumer of a given position. The code is
+ * adapted from
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+
+typedef struct mpmc_cell_t {
+    _Atomic(size_t) seq;
+    void           *value;
+} mpmc_cell_t;
+
+typedef struct mpmc_queue_t {
+    size_t mask;                /* capacity - 1 */
+
+    /* Producer part */
+    _Atomic(size_t) tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    /* Consumer part */
+    _Atomic(size_t) head __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    /* Threads waiting for the queue not to be empty */
+    atomic_uint pop_waiters __attribute__((aligned(CACHE_LINE_SIZE)));
+    thr_evc_t   not_empty;
+    /* Threads waiting for the queue not to be full */
+    atomic_uint push_waiters __attribute__((aligned(CACHE_LINE_SIZE)));
+    thr_evc_t   not_full;
+
+    mpmc_cell_t cells[] __attribute__((aligned(CACHE_LINE_SIZE)));
+} mpmc_queue_t;
+
+/** \brief create an mpmc queue.
+ *
+ * \param[in]  capacity  the maximum number of elements in the queue, rounded
+ *                       up to the next power of 2.
+ */
+mpmc_queue_t *mpmc_queue_new(size_t capacity) __leaf;
+void mpmc_queue_delete(mpmc_queue_t **q) __leaf;
+
+/** \brief wake up the threads waiting on \p ec, if any.
+ *
+ * The full barrier orders the update of the cells before the check of the
+ * waiters, a waiter always registers itself before it checks the cells.
+ */
+static ALWAYS_INLINE
+void mpmc_queue_wake(atomic_uint *waiters, thr_evc_t *ec, int count)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (unlikely(atomic_load_explicit(waiters, memory_order_relaxed))) {
+        thr_ec_signal_n(ec, count);
+    }
+}
+
+/** \brief push a value in the queue.
+ *
+ * \returns false if the queue is full.
+ */
+static inline bool mpmc_queue_push(mpmc_queue_t *q, void *v)
+{
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    mpmc_cell_t *cell;
+
+    for (;;) {
+        size_t seq;
+
+        cell = &q->cells[pos & q->mask];
+        seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        } else
+        if ((ssize_t)(seq - pos) < 0) {
+            /* the cell still holds the value of the previous lap */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+
+    cell->value = v;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    mpmc_queue_wake(&q->pop_waiters, &q->not_empty, 1);
+    return true;
+}
+
+/** \brief pop a value from the queue.
+ *
+ * \returns false if the queue is empty, or if the value of the first
+ *          position is being pushed.
+ */
+static inline bool mpmc_queue_pop(mpmc_queue_t *q, void **v)
+{
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    mpmc_cell_t *cell;
+
+    for (;;) {
+        size_t seq;
+
+        cell = &q->cells[pos & q->mask];
+        seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq == pos + 1) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        } else
+        if ((ssize_t)(seq - (pos + 1)) < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    *v = cell->value;
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+    mpmc_queue_wake(&q->push_waiters, &q->not_full, 1);
+    return true;
+}
+
+/** \brief push up to \p n values in the queue.
+ *
+ * \returns the number of values pushed, which is less than \p n when the
+ *          queue gets full.
+ */
+size_t mpmc_queue_push_n(mpmc_queue_t *q, void * const *v, size_t n) __leaf;
+
+/** \brief pop up to \p n values from the queue.
+ *
+ * \returns the number of values popped.
+ */
+size_t mpmc_queue_pop_n(mpmc_queue_t *q, void **v, size_t n) __leaf;
+
+/** \brief push a value, waiting for the queue not to be full. */
+void mpmc_queue_push_wait(mpmc_queue_t *q, void *v);
+
+/** \brief push \p n values, waiting for the queue not to be full. */
+void mpmc_queue_push_n_wait(mpmc_queue_t *q, void * const *v, size_t n);
+
+/** \brief pop a value, waiting for the queue not to be empty. */
+void *mpmc_queue_pop_wait(mpmc_queue_t *q);
+
+/** \brief pop up to \p n values, waiting for at least one. */
+size_t mpmc_queue_pop_n_wait(mpmc_queue_t *q, void **v, size_t n);
+
+/** \brief returns the number of values in the queue (racy). */
+static inline size_t mpmc_queue_size(mpmc_queue_t *q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    return (ssize_t)(tail - head) > 0 ? tail - head : 0;
+}
+
+#endif
@@ -85,6 +85,7 @@
 #endif
 
 typedef struct ev_t *el_t;
+typedef struct el_loop_t el_loop_t;
 
 /* XXX el_data_t is deprecated and will be removed in a future version
  * of the lib-common.
@@ -271,6 +272,21 @@ int   el_fds_loop(el_t nonnull * nonnull els, int el_count, int timeout,
 
 short el_fd_get_mask(el_t nonnull) __leaf __attribute__((pure));
 short el_fd_set_mask(el_t nonnull, short events) __leaf;
+
+/** Switch a file descriptor to edge-triggered (EPOLLET) notifications.
+ *
+ * The callback is then only called when new events occur on the file
+ * descriptor: it must consume all the available data (or write until the
+ * socket buffer is full) before returning, since the remaining data is not
+ * reported again. This avoids re-arming hot file descriptors on every
+ * iteration of the loop.
+ *
+ * Like the mask changes, this is committed right before the next wait of
+ * the loop.
+ *
+ * \return whether the fd was already edge-triggered.
+ */
+bool  el_fd_set_edge_triggered(el_t nonnull, bool edge) __leaf;
 int   el_fd_get_fd(el_t nonnull) __leaf __attribute__((pure));
 void  el_fd_mark_fired(el_t nonnull) __leaf;
 
@@ -293,6 +309,28 @@ ev_priority_t el_fd_set_priority(el_t nonnull, ev_priority_t priority);
 #define EL_EVENTS_NOACT  ((short)-1)
 int   el_fd_watch_activity(el_t nonnull, short mask, int timeout) __leaf;
 
+typedef enum ev_fd_backend_t {
+    EV_FD_BACKEND_EPOLL,
+    EV_FD_BACKEND_IO_URING,
+} ev_fd_backend_t;
+
+/** Select the kernel interface used to poll the file descriptors.
+ *
+ * The backend is chosen when the fd set of a loop is created: this only
+ * affects the loops that did not register any file descriptor yet (for the
+ * main loop, this is done at module initialization, use the
+ * EL_FD_BACKEND=io_uring environment variable instead).
+ *
+ * When io_uring is not usable on the running kernel, the loops silently fall
+ * back to epoll.
+ *
+ * \return the previously selected backend.
+ */
+ev_fd_backend_t el_fd_set_backend(ev_fd_backend_t backend);
+
+/** Get the backend actually used to poll the fds of the current loop. */
+ev_fd_backend_t el_fd_get_backend(void);
+
 
 /**
  * \defgroup el_wake Waking up event loop from another thread.
@@ -464,6 +502,158 @@ bool el_has_pending_events(void);
 /** Have we received a termination signal? */
 bool el_is_terminating(void);
 
+/**
+ * \defgroup el_loops Event loop instances
+ * \{
+ *
+ * By default, every thread uses the main event loop. A thread can instead be
+ * bound to its own loop, which has its own fd polling set, timers and
+ * before/idle/proxy hooks, so that several threads can each run a reactor
+ * concurrently.
+ *
+ * Events belong to the loop that was current in the thread registering them:
+ * they must be modified and unregistered from the thread running that loop.
+ * Signals, children and fs watches are process-wide, they can only be
+ * registered on the main loop, and so can the big lock (\ref el_bl_use)
+ * only protect the main loop.
+ *
+ * The only operations allowed on a loop from another thread are
+ * \ref el_loop_post_d, \ref el_loop_post_blk and \ref el_loop_unloop.
+ */
+
+typedef void (el_post_f)(data_t);
+
+/** Create a new event loop.
+ *
+ * The loop is not bound to any thread, use \ref el_loop_set_current or
+ * \ref el_loop_run in the thread that will run it.
+ */
+el_loop_t * nonnull el_loop_new(void);
+
+/** Destroy an event loop.
+ *
+ * All the events registered on the loop must have been unregistered first,
+ * and the loop must not be running nor be the current loop of the calling
+ * thread. The jobs still posted on the loop are run before it is destroyed.
+ */
+void el_loop_delete(el_loop_t * nullable * nonnull loop);
+
+/** Get the main event loop. */
+el_loop_t * nonnull el_loop_get_main(void) __leaf __attribute__((pure));
+
+/** Get the event loop bound to the calling thread. */
+el_loop_t * nonnull el_loop_get_current(void) __leaf;
+
+/** Bind an event loop to the calling thread.
+ *
+ * All the el_* functions called afterwards in this thread apply to this
+ * loop.
+ *
+ * \param[in] loop  the loop to bind, NULL means the main loop.
+ * \return the loop previously bound to the thread.
+ */
+el_loop_t * nonnull el_loop_set_current(el_loop_t * nullable loop) __leaf;
+
+/** Run an event loop in the calling thread until it is unlooped.
+ *
+ * This binds the loop to the thread for the duration of the call, then
+ * behaves like \ref el_loop.
+ */
+void el_loop_run(el_loop_t * nonnull loop);
+
+/** Ask an event loop to run a callback.
+ *
+ * This function is thread-safe: the callback is run by the thread running
+ * \p loop, which is woken up if needed.
+ */
+void el_loop_post_d(el_loop_t * nonnull loop, el_post_f * nonnull cb,
+                    data_t priv);
+#ifdef __has_blocks
+void el_loop_post_blk(el_loop_t * nonnull loop, block_t nonnull blk);
+#endif
+static inline void el_loop_post(el_loop_t * nonnull loop,
+                                el_post_f * nonnull cb, void * nullable ptr)
+{
+    el_loop_post_d(loop, cb, (data_t){ ptr });
+}
+
+/** Thread-safe version of \ref el_unloop for a given loop. */
+void el_loop_unloop(el_loop_t * nonnull loop);
+
+/** \} */
+
+/**
+ * \defgroup el_stats Event loop statistics
+ * \{
+ *
+ * Every loop measures its lag: the time each iteration spends doing anything
+ * else than waiting for events, which is how late an event that becomes
+ * ready meanwhile gets processed.
+ *
+ * When enabled with \ref el_loop_profile_callbacks, the loop also times its
+ * callbacks, accumulated per type of callback, and keeps the slowest ones.
+ * The time of a callback includes the one of the callbacks it runs itself
+ * (nested loops, activity timers of fds).
+ */
+
+typedef enum ev_cb_type_t {
+    EV_CB_FD,
+    EV_CB_TIMER,
+    EV_CB_BEFORE,
+    EV_CB_IDLE,
+    EV_CB_PROXY,
+    EV_CB_count,
+} ev_cb_type_t;
+
+/** Upper bound of the first lag bucket, each next one doubles it. */
+#define EL_STATS_LAG_MIN_US    64
+#define EL_STATS_LAG_BUCKETS   16
+#define EL_STATS_SLOWEST_CBS   10
+
+typedef struct el_loop_stats_t {
+    uint64_t iterations;
+    uint64_t lag_sum_us;
+    /* Number of iterations whose lag is within
+     * ]EL_STATS_LAG_MIN_US << (i - 1), EL_STATS_LAG_MIN_US << i] µs, the
+     * last bucket counts the longer ones. */
+    uint64_t lag_buckets[EL_STATS_LAG_BUCKETS + 1];
+
+    struct {
+        uint64_t calls;
+        uint64_t time_ns;
+    } cbs[EV_CB_count];
+
+    /* Slowest callback runs, sorted by decreasing duration, with one entry
+     * per function. */
+    struct {
+        const void * nullable func;
+        ev_cb_type_t type;
+        uint64_t     time_ns;
+    } slowest[EL_STATS_SLOWEST_CBS];
+    int nb_slowest;
+} el_loop_stats_t;
+
+/** Get the statistics of an event loop since its creation.
+ *
+ * It must be called from the thread running the loop (or while the loop
+ * does not run).
+ *
+ * \param[in]  loop   the loop, NULL means the current loop.
+ * \param[out] stats  the statistics of the loop.
+ */
+void el_loop_get_stats(el_loop_t * nullable loop,
+                       el_loop_stats_t * nonnull stats);
+
+/** Enable or disable the profiling of the callbacks of the current loop.
+ *
+ * This costs two clock reads per callback, it is disabled by default.
+ *
+ * \return whether the callbacks were profiled before the call.
+ */
+bool el_loop_profile_callbacks(bool enable);
+
+/** \} */
+
 /**\}*/
 /* Module {{{ */
 
@@ -523,6 +523,21 @@ void prom_histogram_timer_finish(prom_histogram_timer_ctx_t *ctx);
 /* }}} */
 /* {{{ HTTP server for scraping */
 
+/** Expose the allocation profiler on the HTTP server for scraping.
+ *
+ * When enabled, the server started by prom_http_start_server() also exposes
+ * the profile of the allocation profiler (see mem_prof_start()) on
+ * /debug/pprof/heap, in the legacy heap format of pprof, and on
+ * /debug/pprof/heap-collapsed as collapsed in-use stacks.
+ *
+ * Disabled by default: the pprof profile embeds the mappings of the process,
+ * which discloses its address layout to whoever can reach the server.
+ *
+ * \param[in]  expose  whether the profiler endpoints are registered; it must
+ *                     be called before prom_http_start_server().
+ */
+void prom_http_expose_mem_prof(bool expose);
+
 /** Start the HTTP server for scraping.
  *
  * \param[in]  cfg  HTTP configuration of the server.
@@ -544,6 +559,68 @@ int prom_http_start_server(const core__httpd_cfg__t *cfg,
 void prom_http_get_infos(lstr_t * nullable host, in_port_t * nullable port,
                          int * nullable fd);
 
+/* }}} */
+/* {{{ Event loop metrics */
+
+/** Export the statistics of the main event loop.
+ *
+ * It registers the following metrics, refreshed every \p period_ms:
+ *  - el_loop_lag_seconds: histogram of the lag of the loop iterations (see
+ *    \ref el_stats);
+ *  - el_callbacks_total{type} and el_callback_seconds_total{type}: number
+ *    of callbacks run, and time spent in them, per type of callback;
+ *  - el_slowest_callback_seconds{rank,type,symbol}: the slowest callbacks.
+ *    The symbol is only known for exported functions, otherwise it is the
+ *    offset of the function in its object file.
+ *
+ * This enables the profiling of the callbacks of the main loop, it must be
+ * called from the main thread. Calling it again is a no-op.
+ */
+void prom_el_metrics_register(int period_ms);
+
+/* }}} */
+/* {{{ Thread pool metrics */
+
+/** Export the accounting of the threads of the thr-job pool.
+ *
+ * It registers the following metrics, refreshed every \p period_ms (see
+ * \ref thr_worker_stats_t):
+ *  - thr_parallelism: the number of threads running jobs;
+ *  - thr_jobs_queued_total{thread} and thr_jobs_run_total{thread};
+ *  - thr_steals_total{thread,result}: attempts to steal a job, whose result
+ *    is "success", "failed" (another thread won) or "miss" (no job found);
+ *  - thr_idle_seconds_total{thread}: time spent waiting for jobs;
+ *  - thr_queue_depth{thread}: jobs pending in the deque of the thread, when
+ *    the metrics were refreshed.
+ *
+ * It must be called from the main thread. Calling it again is a no-op.
+ */
+void prom_thr_metrics_register(int period_ms);
+
+/* }}} */
+/* {{{ Memory pools metrics */
+
+/** Export the accounting of the memory pools.
+ *
+ * It registers the following metrics, refreshed every \p period_ms (see
+ * mem_pools_get_stats()), labelled by the type, the owner (see
+ * mem_pool_set_owner()) and the name of the pools:
+ *  - mem_pool_used_bytes{type,owner,pool}: bytes in use, for the pools that
+ *    know it;
+ *  - mem_pool_reserved_bytes{type,owner,pool}: bytes reserved from the
+ *    system;
+ *  - mem_pool_reserved_max_bytes{type,owner,pool}: high-water mark of the
+ *    bytes reserved from the system;
+ *  - mem_pool_allocated_bytes_total{type,owner,pool}: bytes allocated, to
+ *    compute the allocation rate.
+ *
+ * The pools having the same labels, such as the t_pool of each thread, are
+ * summed up.
+ *
+ * It must be called from the main thread. Calling it again is a no-op.
+ */
+void prom_mem_metrics_register(int period_ms);
+
 /* }}} */
 /* {{{ Module */
 
@@ -31,6 +31,10 @@ static int prometheus_client_initialize(void *arg)
 
 static int prometheus_client_shutdown(void)
 {
+    prom_el_metrics_unregister();
+    prom_thr_metrics_unregister();
+    prom_mem_metrics_unregister();
+
     dlist_for_each_entry(prom_metric_t, metric, &prom_collector_g,
                          siblings_list)
     {
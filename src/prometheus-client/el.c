@@ -0,0 +1,150 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <dlfcn.h>
+#include <lib-common/el.h>
+
+#include "priv.h"
+
+static struct {
+    el_t timer;
+
+    prom_histogram_t *lag;
+    prom_counter_t *calls[EV_CB_count];
+    prom_counter_t *seconds[EV_CB_count];
+    prom_gauge_t *slowest;
+} prom_el_g;
+#define _G  prom_el_g
+
+static const char *cb_type_names_g[EV_CB_count] = {
+    [EV_CB_FD]     = "fd",
+    [EV_CB_TIMER]  = "timer",
+    [EV_CB_BEFORE] = "before",
+    [EV_CB_IDLE]   = "idle",
+    [EV_CB_PROXY]  = "proxy",
+};
+
+/* {{{ Refresh */
+
+/* Name a callback by its symbol when it is exported, otherwise by its
+ * offset in its object file, which can be resolved with addr2line.
+ */
+static const char *t_get_cb_symbol(const void *func)
+{
+    Dl_info info;
+
+    if (!dladdr(func, &info)) {
+        return t_fmt("%p", func);
+    }
+    if (info.dli_sname) {
+        if (info.dli_saddr == func) {
+            return info.dli_sname;
+        }
+        return t_fmt("%s+%#tx", info.dli_sname,
+                     (const byte *)func - (const byte *)info.dli_saddr);
+    }
+    return t_fmt("%s+%#tx", path_filepart(info.dli_fname),
+                 (const byte *)func - (const byte *)info.dli_fbase);
+}
+
+static void prom_el_refresh(el_t ev, data_t priv)
+{
+    t_scope;
+    el_loop_stats_t st;
+    uint64_t count = 0;
+
+    el_loop_get_stats(el_loop_get_main(), &st);
+
+    /* The loop already sorted the lags in buckets, so the histogram is
+     * overwritten rather than observed. */
+    spin_lock(&_G.lag->lock);
+    for (int i = 0; i < _G.lag->nb_buckets; i++) {
+        count += st.lag_buckets[i];
+        _G.lag->bucket_counts[i] = count;
+    }
+    _G.lag->count = st.iterations;
+    _G.lag->sum   = st.lag_sum_us / 1e6;
+    spin_unlock(&_G.lag->lock);
+
+    for (int i = 0; i < EV_CB_count; i++) {
+        prom_metric_set_value(_G.calls[i], st.cbs[i].calls);
+        prom_metric_set_value(_G.seconds[i], st.cbs[i].time_ns / 1e9);
+    }
+
+    obj_vcall(_G.slowest, clear);
+    for (int i = 0; i < st.nb_slowest; i++) {
+        prom_gauge_t *gauge;
+
+        gauge = prom_gauge_labels(_G.slowest, t_fmt("%d", i + 1),
+                                  cb_type_names_g[st.slowest[i].type],
+                                  t_get_cb_symbol(st.slowest[i].func));
+        obj_vcall(gauge, set, st.slowest[i].time_ns / 1e9);
+    }
+}
+
+/* }}} */
+/* {{{ API */
+
+void prom_el_metrics_register(int period_ms)
+{
+    if (_G.timer) {
+        return;
+    }
+
+    _G.lag = prom_histogram_new("el_loop_lag_seconds",
+                                "Time spent by the main event loop "
+                                "iterations doing anything else than "
+                                "waiting for events");
+    prom_histogram_set_exponential_buckets(_G.lag,
+                                           EL_STATS_LAG_MIN_US / 1e6, 2,
+                                           EL_STATS_LAG_BUCKETS);
+
+    {
+        prom_counter_t *calls;
+        prom_counter_t *seconds;
+
+        calls = prom_counter_new("el_callbacks_total",
+                                 "Number of callbacks run by the main "
+                                 "event loop", "type");
+        seconds = prom_counter_new("el_callback_seconds_total",
+                                   "Time spent in the callbacks run by the "
+                                   "main event loop", "type");
+        for (int i = 0; i < EV_CB_count; i++) {
+            _G.calls[i] = prom_counter_labels(calls, cb_type_names_g[i]);
+            _G.seconds[i] = prom_counter_labels(seconds, cb_type_names_g[i]);
+        }
+    }
+
+    _G.slowest = prom_gauge_new("el_slowest_callback_seconds",
+                                "Duration of the slowest callbacks run by "
+                                "the main event loop",
+                                "rank", "type", "symbol");
+
+    el_loop_profile_callbacks(true);
+    _G.timer = el_timer_register(period_ms, period_ms, EL_TIMER_LOWRES,
+                                 &prom_el_refresh, NULL);
+    el_unref(_G.timer);
+}
+
+void prom_el_metrics_unregister(void)
+{
+    el_unregister(&_G.timer);
+    p_clear(&_G, 1);
+}
+
+/* }}} */
@@ -28,6 +28,8 @@ static struct {
 
     el_t httpd;
     httpd_cfg_t *httpd_cfg;
+
+    bool expose_mem_prof;
 } prom_http_g = {
 #define _G  prom_http_g
     .logger = LOGGER_INIT_INHERITS(&prom_logger_g, "http"),
@@ -59,6 +61,54 @@ static void metrics_query_hook(httpd_trigger_t *tcb, struct httpd_query_t *q,
     q->qinfo   = httpd_qinfo_dup(qi);
 }
 
+/* }}} */
+/* {{{ "debug/pprof/heap" query */
+
+static void mem_prof_query_reply(httpd_query_t *q, bool collapsed)
+{
+    SB_8k(buf);
+    outbuf_t *ob;
+
+    ob = httpd_reply_hdrs_start(q, HTTP_CODE_OK, true);
+    ob_adds(ob, "Content-Type: text/plain\n");
+    httpd_reply_hdrs_done(q, -1, false);
+
+    if (collapsed) {
+        mem_prof_dump_collapsed(&buf, true);
+    } else {
+        mem_prof_dump_pprof(&buf);
+    }
+    ob_addsb(ob, &buf);
+
+    httpd_reply_done(q);
+}
+
+static void mem_prof_pprof_query_on_done(httpd_query_t *q)
+{
+    mem_prof_query_reply(q, false);
+}
+
+static void mem_prof_collapsed_query_on_done(httpd_query_t *q)
+{
+    mem_prof_query_reply(q, true);
+}
+
+static void mem_prof_pprof_query_hook(httpd_trigger_t *tcb,
+                                      struct httpd_query_t *q,
+                                      const httpd_qinfo_t *qi)
+{
+    q->on_done = mem_prof_pprof_query_on_done;
+    q->qinfo   = httpd_qinfo_dup(qi);
+}
+
+static void mem_prof_collapsed_query_hook(httpd_trigger_t *tcb,
+                                          struct httpd_query_t *q,
+                                          const httpd_qinfo_t *qi)
+{
+    q->on_done = mem_prof_collapsed_query_on_done;
+    q->qinfo   = httpd_qinfo_dup(qi);
+}
+
 /* }}} */
 /* {{{ API */
 
@@ -105,11 +155,29 @@ int prom_http_start_server(const core__httpd_cfg__t *cfg,
     trigger->cb = metrics_query_hook;
     httpd_trigger_register(_G.httpd_cfg, GET, "/metrics", trigger);
 
+    /* Register the allocation profiler triggers, only on demand since the
+     * profiles disclose the address layout of the process. */
+    if (_G.expose_mem_prof) {
+        trigger     = httpd_trigger_new();
+        trigger->cb = mem_prof_pprof_query_hook;
+        httpd_trigger_register(_G.httpd_cfg, GET, "/debug/pprof/heap",
+                               trigger);
+        trigger     = httpd_trigger_new();
+        trigger->cb = mem_prof_collapsed_query_hook;
+        httpd_trigger_register(_G.httpd_cfg, GET,
+                               "/debug/pprof/heap-collapsed", trigger);
+    }
+
     logger_notice(&_G.logger, "listening for prometheus scraping on %*pM",
                   LSTR_FMT_ARG(addr));
     return 0;
 }
 
+void prom_http_expose_mem_prof(bool expose)
+{
+    _G.expose_mem_prof = expose;
+}
+
 void prom_http_get_infos(lstr_t * nullable host, in_port_t * nullable port,
                          int * nullable fd)
 {
@@ -0,0 +1,168 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/container-qhash.h>
+#include <lib-common/el.h>
+
+#include "priv.h"
+
+/* Bytes allocated by each pool, by address. */
+qm_k64_t(prom_mem_allocated, uint64_t);
+
+static struct {
+    el_t timer;
+
+    prom_gauge_t   *used;
+    prom_gauge_t   *reserved;
+    prom_gauge_t   *reserved_max;
+    prom_counter_t *allocated;
+
+    /* Bytes allocated by the pools seen at the last refresh. */
+    qm_t(prom_mem_allocated) last_allocated;
+} prom_mem_g;
+#define _G  prom_mem_g
+
+/* {{{ Refresh */
+
+qm_kvec_t(prom_mem_pools, lstr_t, mem_pool_stats_t, qhash_lstr_hash,
+          qhash_lstr_equal);
+
+typedef struct prom_mem_refresh_t {
+    qm_t(prom_mem_pools)     pools;
+    qm_t(prom_mem_allocated) allocated;
+} prom_mem_refresh_t;
+
+/* The pools with the same type, owner and name (such as the t_pool of each
+ * thread) are summed.
+ *
+ * The allocated bytes are summed as the increase since the last refresh,
+ * that is added to the counters: the counters keep what was allocated by the
+ * deleted pools, and never decrease. What a pool allocates between the last
+ * refresh and its deletion is lost.
+ */
+static void prom_mem_add_pool(const mem_pool_stats_t *st, void *priv)
+{
+    prom_mem_refresh_t *ctx = priv;
+    const char *owner = st->owner ?: "";
+    lstr_t key = t_lstr_fmt("%s%c%s%c%s", st->type, '\0', owner, '\0',
+                            st->name);
+    uint32_t pos = qm_reserve(prom_mem_pools, &ctx->pools, &key, 0);
+    mem_pool_stats_t *sum = &ctx->pools.values[pos & ~QHASH_COLLISION];
+    uint64_t last = 0;
+    int last_pos;
+
+    last_pos = qm_find(prom_mem_allocated, &_G.last_allocated,
+                       (uintptr_t)st->pool);
+    if (last_pos >= 0) {
+        last = _G.last_allocated.values[last_pos];
+        /* A new pool at the address of a deleted one. */
+        if (last > st->allocated) {
+            last = 0;
+        }
+    }
+    qm_add(prom_mem_allocated, &ctx->allocated, (uintptr_t)st->pool,
+           st->allocated);
+
+    if (!(pos & QHASH_COLLISION)) {
+        *sum = (mem_pool_stats_t){
+            .type  = t_strdup(st->type),
+            .name  = t_strdup(st->name),
+            .owner = t_strdup(owner),
+            .used  = -1,
+        };
+    }
+    if (st->used >= 0) {
+        sum->used = MAX(sum->used, 0) + st->used;
+    }
+    sum->reserved     += st->reserved;
+    sum->reserved_hwm += st->reserved_hwm;
+    sum->allocated    += st->allocated - last;
+}
+
+static void prom_mem_refresh(el_t ev, data_t priv)
+{
+    t_scope;
+    prom_mem_refresh_t ctx;
+
+    t_qm_init(prom_mem_pools, &ctx.pools, 64);
+    qm_init(prom_mem_allocated, &ctx.allocated);
+    mem_pools_get_stats(&prom_mem_add_pool, &ctx);
+    qm_wipe(prom_mem_allocated, &_G.last_allocated);
+    _G.last_allocated = ctx.allocated;
+
+    /* Start from scratch so that the deleted pools disappear, except from
+     * the counters of the allocated bytes. */
+    obj_vcall(_G.used, clear);
+    obj_vcall(_G.reserved, clear);
+    obj_vcall(_G.reserved_max, clear);
+
+    qm_for_each_value_p(prom_mem_pools, st, &ctx.pools) {
+        if (st->used >= 0) {
+            prom_metric_set_value(prom_gauge_labels(_G.used, st->type,
+                                                    st->owner, st->name),
+                                  st->used);
+        }
+        prom_metric_set_value(prom_gauge_labels(_G.reserved, st->type,
+                                                st->owner, st->name),
+                              st->reserved);
+        prom_metric_set_value(prom_gauge_labels(_G.reserved_max, st->type,
+                                                st->owner, st->name),
+                              st->reserved_hwm);
+        obj_vcall(prom_counter_labels(_G.allocated, st->type, st->owner,
+                                      st->name),
+                  add, st->allocated);
+    }
+}
+
+/* }}} */
+/* {{{ API */
+
+void prom_mem_metrics_register(int period_ms)
+{
+    if (_G.timer) {
+        return;
+    }
+
+    _G.used = prom_gauge_new("mem_pool_used_bytes",
+                             "Bytes in use in the memory pools",
+                             "type", "owner", "pool");
+    _G.reserved = prom_gauge_new("mem_pool_reserved_bytes",
+                                 "Bytes reserved from the system by the "
+                                 "memory pools", "type", "owner", "pool");
+    _G.reserved_max = prom_gauge_new("mem_pool_reserved_max_bytes",
+                                     "Highest number of bytes reserved from "
+                                     "the system by the memory pools",
+                                     "type", "owner", "pool");
+    _G.allocated = prom_counter_new("mem_pool_allocated_bytes_total",
+                                    "Bytes allocated in the memory pools",
+                                    "type", "owner", "pool");
+
+    qm_init(prom_mem_allocated, &_G.last_allocated);
+    _G.timer = el_timer_register(period_ms, period_ms, EL_TIMER_LOWRES,
+                                 &prom_mem_refresh, NULL);
+    el_unref(_G.timer);
+}
+
+void prom_mem_metrics_unregister(void)
+{
+    el_unregister(&_G.timer);
+    qm_wipe(prom_mem_allocated, &_G.last_allocated);
+    p_clear(&_G, 1);
+}
+
+/* }}} */
@@ -342,6 +342,16 @@ prom_simple_value_metric_get_value(prom_simple_value_metric_t *self)
     return res;
 }
 
+void prom_simple_value_metric_set(prom_simple_value_metric_t *metric,
+                                  double value)
+{
+    if (expect(is_metric_observable(&metric->super))) {
+        spin_lock(&metric->lock);
+        metric->value = value;
+        spin_unlock(&metric->lock);
+    }
+}
+
 OBJ_VTABLE(prom_simple_value_metric)
     prom_simple_value_metric.get_value = prom_simple_value_metric_get_value;
 OBJ_VTABLE_END()
@@ -401,11 +411,7 @@ static void prom_gauge_dec(prom_gauge_t *self)
 
 static void prom_gauge_set(prom_gauge_t *self, double value)
 {
-    if (expect(is_metric_observable(&self->super.super))) {
-        spin_lock(&self->lock);
-        self->value = value;
-        spin_unlock(&self->lock);
-    }
+    prom_simple_value_metric_set(&self->super, value);
 }
 
 OBJ_VTABLE(prom_gauge)
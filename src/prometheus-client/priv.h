@@ -56,6 +56,32 @@ int prom_metric_check_label_name(const char *label_name);
  */
 void prom_collector_bridge(const dlist_t *collector, sb_t *out);
 
+/** Set the value of a counter or a gauge.
+ *
+ * Used by the exporters of the statistics of the event loop, the thread pool
+ * and the memory pools, that copy totals maintained elsewhere at each
+ * refresh. Unlike the add() method of the counters, it can lower the value,
+ * for example when the source of a total was reset.
+ */
+void prom_simple_value_metric_set(prom_simple_value_metric_t *metric,
+                                  double value);
+
+#define prom_metric_set_value(metric, value)  \
+    prom_simple_value_metric_set(obj_vcast(prom_simple_value_metric,         \
+                                           metric), (value))
+
+/** Stop refreshing the event loop metrics.
+ *
+ * Called at module shutdown, before the metrics are destroyed.
+ */
+void prom_el_metrics_unregister(void);
+
+/** Stop refreshing the thread pool metrics. */
+void prom_thr_metrics_unregister(void);
+
+/** Stop refreshing the memory pools metrics. */
+void prom_mem_metrics_unregister(void);
+
 /** Module for HTTP server for scraping. */
 MODULE_DECLARE(prometheus_client_http);
 
@@ -0,0 +1,110 @@
+/***************************************************************************/
+/*                                                                         */
+/* Copyright 2022 INTERSEC SA                                              */
+/*                                                                         */
+/* Licensed under the Apache License, Version 2.0 (the "License");         */
+/* you may not use this file except in compliance with the License.        */
+/* You may obtain a copy of the License at                                 */
+/*                                                                         */
+/*     http://www.apache.org/licenses/LICENSE-2.0                          */
+/*                                                                         */
+/* Unless required by applicable law or agreed to in writing, software     */
+/* distributed under the License is distributed on an "AS IS" BASIS,       */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.*/
+/* See the License for the specific language governing permissions and     */
+/* limitations under the License.                                          */
+/*                                                                         */
+/***************************************************************************/
+
+#include <lib-common/el.h>
+#include <lib-common/thr.h>
+
+#include "priv.h"
+
+static struct {
+    el_t timer;
+
+    prom_gauge_t   *parallelism;
+    prom_counter_t *jobs_queued;
+    prom_counter_t *jobs_run;
+    prom_counter_t *steals;
+    prom_counter_t *idle;
+    prom_gauge_t   *queue_depth;
+} prom_thr_g;
+#define _G  prom_thr_g
+
+/* {{{ Refresh */
+
+static void prom_thr_refresh(el_t ev, data_t priv)
+{
+    t_scope;
+    thr_worker_stats_t *stats;
+    int nb = thr_get_worker_stats(NULL, 0);
+
+    /* Threads may have been started in between, they'll be exported by the
+     * next refresh. */
+    stats = t_new_raw(thr_worker_stats_t, nb);
+    nb = MIN(nb, thr_get_worker_stats(stats, nb));
+
+    obj_vcall(_G.parallelism, set, thr_parallelism_g);
+    for (int i = 0; i < nb; i++) {
+        const thr_worker_stats_t *st = &stats[i];
+        const char *id = t_fmt("%d", st->id);
+
+        prom_metric_set_value(prom_counter_labels(_G.jobs_queued, id),
+                              st->jobs_queued);
+        prom_metric_set_value(prom_counter_labels(_G.jobs_run, id),
+                              st->jobs_run);
+        prom_metric_set_value(prom_counter_labels(_G.steals, id, "success"),
+                              st->steals);
+        prom_metric_set_value(prom_counter_labels(_G.steals, id, "failed"),
+                              st->failed_steals);
+        prom_metric_set_value(prom_counter_labels(_G.steals, id, "miss"),
+                              st->steal_misses);
+        prom_metric_set_value(prom_counter_labels(_G.idle, id),
+                              st->idle_ns / 1e9);
+        obj_vcall(prom_gauge_labels(_G.queue_depth, id), set,
+                  st->queue_depth);
+    }
+}
+
+/* }}} */
+/* {{{ API */
+
+void prom_thr_metrics_register(int period_ms)
+{
+    if (_G.timer) {
+        return;
+    }
+
+    _G.parallelism = prom_gauge_new("thr_parallelism",
+                                    "Number of threads running jobs");
+    _G.jobs_queued = prom_counter_new("thr_jobs_queued_total",
+                                      "Number of jobs scheduled from a "
+                                      "thread", "thread");
+    _G.jobs_run = prom_counter_new("thr_jobs_run_total",
+                                   "Number of jobs run by a thread",
+                                   "thread");
+    _G.steals = prom_counter_new("thr_steals_total",
+                                 "Number of attempts of a thread to steal "
+                                 "a job from the others, by result",
+                                 "thread", "result");
+    _G.idle = prom_counter_new("thr_idle_seconds_total",
+                               "Time spent by a thread waiting for jobs",
+                               "thread");
+    _G.queue_depth = prom_gauge_new("thr_queue_depth",
+                                    "Number of jobs pending in the deque of "
+                                    "a thread", "thread");
+
+    _G.timer = el_timer_register(period_ms, period_ms, EL_TIMER_LOWRES,
+                                 &prom_thr_refresh, NULL);
+    el_unref(_G.timer);
+}
+
+void prom_thr_metrics_unregister(void)
+{
+    el_unregister(&_G.timer);
+    p_clear(&_G, 1);
+}
+
+/* }}} */
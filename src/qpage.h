@@ -33,6 +33,25 @@
 #define QPAGE_COUNT_MAX     (1U << QPAGE_COUNT_BITS)
 #define QPAGE_ALLOC_MAX     (1U << (QPAGE_COUNT_BITS + QPAGE_SHIFT))
 
+/** Kind of pages backing the arenas of the allocator. */
+typedef enum qpage_huge_t {
+    /** Regular pages. */
+    QPAGE_HUGE_NONE,
+    /** Transparent huge pages, the arenas are aligned on 2MB and advised
+     * with MADV_HUGEPAGE. */
+    QPAGE_HUGE_THP,
+    /** Huge pages from the hugetlbfs pool (see vm.nr_hugepages), falling
+     * back on transparent huge pages when none are available. */
+    QPAGE_HUGE_HUGETLB,
+} qpage_huge_t;
+
+/** Select the kind of pages backing the arenas created from now on.
+ *
+ * Huge pages reduce the TLB misses of random accesses in large page sets,
+ * at the cost of releasing memory to the system by chunks of 2MB only.
+ */
+void qpage_set_huge_pages(qpage_huge_t mode);
+
 void *qpage_alloc_align(size_t n, size_t shift, uint32_t *seg);
 void *qpage_allocraw_align(size_t n, size_t shift, uint32_t *seg);
 
@@ -20,6 +20,7 @@
 #define IS_LIB_COMMON_QPS_BITMAP_H
 
 #include <lib-common/qps.h>
+#include <lib-common/bit.h>
 
 /** \defgroup qkv__ll__bitmap QPS Bitmap
  * \ingroup qkv__ll
@@ -121,6 +122,27 @@ qps_bitmap_state_t qps_bitmap_set(qps_bitmap_t *map, uint32_t row) __leaf;
 qps_bitmap_state_t qps_bitmap_reset(qps_bitmap_t *map, uint32_t row) __leaf;
 qps_bitmap_state_t qps_bitmap_remove(qps_bitmap_t *map, uint32_t row) __leaf;
 
+/** Get the state of several rows.
+ *
+ * Same as calling qps_bitmap_get() for each of the \p count \p rows, but
+ * the lookups are interleaved by small batches: the nodes of each level are
+ * prefetched for the whole batch before being read, so that the cache
+ * misses of random lookups overlap instead of being paid one after the
+ * other.
+ */
+void qps_bitmap_get_many(qps_bitmap_t *map, const uint32_t *rows,
+                         uint32_t count, qps_bitmap_state_t *states) __leaf;
+
+/** Get the state of a row from a read section of the qps.
+ *
+ * Same as qps_bitmap_get() for the concurrent readers of the qps (see
+ * qps_reader_enter()): the bitmap is given by its handle and the pages are
+ * checked before being read. The writer may be modifying the bitmap, the
+ * result is only meaningful if the caller checks it did not meanwhile.
+ */
+qps_bitmap_state_t qps_bitmap_reader_get(qps_t *qps, qps_handle_t handle,
+                                         uint32_t row) __leaf;
+
 void qps_bitmap_compute_stats(qps_bitmap_t *map, size_t *memory,
                               uint32_t *entries, uint32_t *slots) __leaf;
 
@@ -133,6 +155,57 @@ qps_bitmap_init(qps_bitmap_t *map, qps_t *qps, qps_handle_t handle)
     assert (strequal(QPS_BITMAP_SIG, (const char *)map->root->sig));
 }
 
+/* }}} */
+/* Set operations {{{ */
+
+/** \name Set operations
+ *
+ * These operations work leaf by leaf on the words of the two bitmaps
+ * instead of row by row: subtrees absent from one of the operands are
+ * skipped or dropped at once.
+ *
+ * The bitmap modified in place must not be nullable. The other operand
+ * may be: its rows at 1 are then the set ones, its rows at 0 or NULL the
+ * unset ones. The two operands must be different bitmaps, but they may
+ * live in different qps.
+ *
+ * \{
+ */
+
+/** Keep in \p map the rows that are also set in \p other. */
+void qps_bitmap_and(qps_bitmap_t *map, qps_bitmap_t *other) __leaf;
+
+/** Set in \p map the rows set in \p other. */
+void qps_bitmap_or(qps_bitmap_t *map, qps_bitmap_t *other) __leaf;
+
+/** Unset in \p map the rows set in \p other. */
+void qps_bitmap_and_not(qps_bitmap_t *map, qps_bitmap_t *other) __leaf;
+
+/** Count the rows at 1 in the range [\p first, \p last].
+ *
+ * The leaves of a non-nullable bitmap fully in the range are counted
+ * without being read.
+ */
+uint64_t qps_bitmap_count_range(qps_bitmap_t *map, uint32_t first,
+                                uint32_t last) __leaf;
+
+/** Get the rows at 1 of a bitmap as a WAH.
+ *
+ * \p wah is reset, then bit \p n of it is set for each row \p n at 1 in
+ * \p map. Its length is the last row at 1 plus one.
+ */
+void qps_bitmap_to_wah(qps_bitmap_t *map, wah_t *wah) __leaf;
+
+/** Set the rows of a bitmap from a WAH.
+ *
+ * Row \p n of \p map is set to 1 for each bit \p n set in \p wah, the
+ * other rows are left untouched. The WAH is read word by word, runs of 0s
+ * are skipped at once.
+ */
+void qps_bitmap_from_wah(qps_bitmap_t *map, const wah_t *wah) __leaf;
+
+/** \} */
+
 /* }}} */
 /* {{{ Bitmap enumerator */
 
@@ -181,6 +181,10 @@ typedef struct qhat_t {
     const struct qhat_desc_t *desc;
 
     bool do_stats;
+
+    /* Odd while the writer modifies the trie, see qhat_write_begin(). */
+    atomic_uint32_t write_seq;
+    uint32_t        write_depth;
 } qhat_t;
 
 typedef struct qhat_path_t {
@@ -288,6 +292,61 @@ static ALWAYS_INLINE void qhat_path_touch(qhat_path_t *path)
 #endif /* NDEBUG */
 }
 
+/** Start a modification of the trie, for the concurrent readers.
+ *
+ * Everything done until \ref qhat_write_end is one modification for the
+ * readers (see qhat_reader_get()). The functions that modify the trie
+ * already do it when readers are enabled on the qps, it is only needed
+ * around the writes through the pointers returned by \ref qhat_set. The
+ * calls can be nested.
+ */
+static ALWAYS_INLINE void qhat_write_begin(qhat_t *hat)
+{
+    uint32_t seq;
+
+    if (hat->write_depth++) {
+        return;
+    }
+    seq = atomic_load_explicit(&hat->write_seq, memory_order_relaxed);
+    assert (!(seq & 1));
+    atomic_store_explicit(&hat->write_seq, seq + 1, memory_order_relaxed);
+    /* the readers must see the sequence change before any write */
+    atomic_thread_fence(memory_order_release);
+}
+
+/** End a modification of the trie started by \ref qhat_write_begin.
+ */
+static ALWAYS_INLINE void qhat_write_end(qhat_t *hat)
+{
+    uint32_t seq;
+
+    assert (hat->write_depth > 0);
+    if (--hat->write_depth) {
+        return;
+    }
+    seq = atomic_load_explicit(&hat->write_seq, memory_order_relaxed);
+    assert (seq & 1);
+    atomic_store_explicit(&hat->write_seq, seq + 1, memory_order_release);
+}
+
+/* Brackets the modifications done by the qhat functions, when the qps has
+ * concurrent readers. */
+static ALWAYS_INLINE bool qhat_mutation_begin(qhat_t *hat)
+{
+    if (likely(!hat->qps->epoch)) {
+        return false;
+    }
+    qhat_write_begin(hat);
+    return true;
+}
+
+static ALWAYS_INLINE void qhat_mutation_end(qhat_t *hat, bool readers)
+{
+    if (readers) {
+        qhat_write_end(hat);
+    }
+}
+
 /** Remove the value described by a path.
  *
  * \param[in,out] path Already resolved path to the key in the trie.
@@ -298,9 +357,11 @@ static ALWAYS_INLINE void qhat_path_touch(qhat_path_t *path)
 static ALWAYS_INLINE
 bool qhat_remove_path(qhat_path_t *path, void *ptr)
 {
+    bool readers = qhat_mutation_begin(path->hat);
     bool removed;
 
     removed = (*path->hat->desc->removef)(path, ptr);
+    qhat_mutation_end(path->hat, readers);
     qhat_path_touch(path);
     return removed;
 }
@@ -332,20 +393,31 @@ bool qhat_remove(qhat_t *hat, uint32_t row, void *ptr)
  * \warning You must not set the returned slot to 0, if you wish to store 0s
  * in the trie, use \ref qhat_set0 or \ref qhat_set0_path.
  *
+ * \warning When readers are enabled on the qps (see qps_readers_enable()),
+ * the writes through the returned pointer must be done between \ref
+ * qhat_write_begin and \ref qhat_write_end, or the concurrent readers may
+ * return a value being written.
+ *
  * \param[in,out] path Already resolved path to the key in the trie.
  * \return A pointer to the slot associated to the key in the trie.
  */
 static ALWAYS_INLINE
 void *qhat_set_path(qhat_path_t *path)
 {
+    bool readers = qhat_mutation_begin(path->hat);
     void *value_ptr;
 
     value_ptr = (*path->hat->desc->setf)(path);
+    qhat_mutation_end(path->hat, readers);
     qhat_path_touch(path);
     return value_ptr;
 }
 
-/** Get a read-only pointer to the value associated with a key.
+/** Get a read-write pointer to the value associated with a key.
+ *
+ * As for \ref qhat_set_path, the writes through the returned pointer must be
+ * done between \ref qhat_write_begin and \ref qhat_write_end when readers
+ * are enabled.
  *
  * \see qhat_set_path
  */
@@ -369,7 +441,10 @@ void *qhat_set(qhat_t *hat, uint32_t row)
 static ALWAYS_INLINE
 void qhat_set0_path(qhat_path_t *path, void *ptr)
 {
+    bool readers = qhat_mutation_begin(path->hat);
+
     (*path->hat->desc->set0f)(path, ptr);
+    qhat_mutation_end(path->hat, readers);
     qhat_path_touch(path);
 }
 
@@ -412,6 +487,19 @@ const void *qhat_get(qhat_t *hat, uint32_t row)
     return qhat_get_path(&path);
 }
 
+/** Get read-only pointers to the values associated with several keys.
+ *
+ * Same as calling \ref qhat_get for each of the \p count \p rows, the
+ * pointer returned for \p rows[i] being stored in \p values[i]. The lookups
+ * are interleaved by small batches: each depth of the trie is prefetched
+ * for the whole batch before being read, so that the cache misses of
+ * random lookups overlap instead of being paid one after the other.
+ *
+ * The pointers are valid until the next modification of the trie.
+ */
+void qhat_get_many(qhat_t *hat, const uint32_t *rows, uint32_t count,
+                   const void **values) __leaf;
+
 /** Check if an entry is NULL.
  */
 static ALWAYS_INLINE
@@ -486,6 +574,100 @@ int qhat_check_consistency(qhat_t *hat, bool *nullable is_suboptimal) __leaf;
  */
 void qhat_fix_stored0(qhat_t *hat) __leaf;
 
+/** \} */
+/** \name Bulk load
+ * \{
+ *
+ * Populate an empty trie from rows sorted in strictly increasing order.
+ *
+ * Instead of inserting the rows one by one from the root, the loader
+ * buffers them and builds the leaves and the dispatch nodes bottom-up, at
+ * their final layout: a compact leaf is filled up to the split threshold of
+ * the trie (so that later insertions do not split it immediately), a slot
+ * holding more rows than that becomes a dispatch node whose rows are loaded
+ * one level deeper (or a flat leaf at the last level of the trie), and each
+ * page is written once. The result is a trie equivalent to the one built by calling \ref
+ * qhat_set for each row, but without the intermediate flatten and split
+ * operations.
+ *
+ * The values are passed as a packed array of slots of the trie value size
+ * (\p desc->value_len: 1, 2, 4, 8 or 16 bytes). Zero values are not stored;
+ * on nullable tries they only mark the row as set, as \ref qhat_set0 does.
+ *
+ * The trie must not be accessed between \ref qhat_bulk_load_start and
+ * \ref qhat_bulk_load_finish.
+ */
+
+typedef struct qhat_bulk_loader_t qhat_bulk_loader_t;
+
+/** Start a bulk load of an empty trie.
+ */
+qhat_bulk_loader_t *qhat_bulk_load_start(qhat_t *hat);
+
+/** Feed a run of rows to a bulk load.
+ *
+ * \param[in] rows    \p count rows, greater than all the rows already fed
+ *                    to the loader, in strictly increasing order.
+ * \param[in] values  \p count values of \p desc->value_len bytes each.
+ */
+void qhat_bulk_load_add(qhat_bulk_loader_t *loader, const uint32_t *rows,
+                        const void *values, uint32_t count);
+
+/** Finish a bulk load: flush the buffered rows and release the loader.
+ */
+void qhat_bulk_load_finish(qhat_bulk_loader_t **loader);
+
+/** Bulk load an empty trie from a single run of sorted rows.
+ */
+void qhat_bulk_load(qhat_t *hat, const uint32_t *rows, const void *values,
+                    uint32_t count);
+
+/** \} */
+/** \name Concurrent readers
+ * \{
+ *
+ * Read the trie from other threads while the writer modifies it.
+ *
+ * The memory released by the writer is protected by the epoch-based
+ * reclamation of the qps, that must have been enabled with
+ * qps_readers_enable(). What the readers see may still be being written,
+ * so each modification of the trie is bracketed with \ref qhat_write_begin
+ * and \ref qhat_write_end, and a reader retries when a modification ran
+ * during its lookup (a sequence lock). The functions that modify the trie
+ * do it themselves, the writer only brackets \ref qhat_set with the write
+ * through the pointer it returns. The values are copied out, the readers
+ * never get pointers in the trie.
+ *
+ * The trie must not be destroyed, cleared or unloaded while readers run.
+ */
+
+/** Get the value associated with a key from a concurrent reader.
+ *
+ * \param[out] value  filled with the value (\p desc->value_len bytes),
+ *                    zeros if the key has none.
+ * \return false if the key is NULL on a nullable trie, or if its value is
+ *         zero on a non-nullable trie.
+ */
+bool qhat_reader_get(qhat_t *hat, uint32_t row, void *value) __leaf;
+
+/** Enumerate the trie from a concurrent reader.
+ *
+ * Fetches, in increasing order, at most \p max of the keys greater than or
+ * equal to \p *from that have a non-zero value, and moves \p *from after
+ * the last one. The keys set to zero of nullable tries are skipped.
+ *
+ * Each call sees a consistent state of the trie, but the trie may be
+ * modified between two calls: a full enumeration is a loop of calls, with
+ * \p *from starting at 0.
+ *
+ * \param[in,out] from  first key to look at, UINT32_MAX + 1 at the end.
+ * \param[out] rows     the keys fetched.
+ * \param[out] values   their values, \p desc->value_len bytes each.
+ * \return the number of keys fetched, 0 at the end of the trie.
+ */
+uint32_t qhat_reader_fetch(qhat_t *hat, uint64_t *from, uint32_t *rows,
+                           void *values, uint32_t max) __leaf;
+
 /** \} */
 /* Enumeration API
  */
@@ -165,9 +165,12 @@ typedef struct qps_cowhdr_t qps_cowhdr_t;
 typedef struct qps_mhdr_t   qps_mhdr_t;
 typedef union  qps_map_t    qps_map_t;
 typedef struct qps_gcmap_t  qps_gcmap_t;
+typedef struct qps_gc_t     qps_gc_t;
+typedef struct qps_snap_map_t qps_snap_map_t;
 qvector_t(qps_handle, qps_handle_t);
 qvector_t(qps_pg,     qps_pg_t);
 qvector_t(qpsm,       qps_map_t *);
+qvector_t(qps_snap_map, qps_snap_map_t *);
 
 static inline int qps_gen_cmp(uint32_t gen1, uint32_t gen2)
 {
@@ -192,6 +195,16 @@ union qps_map_t {
 #define QPS_MAP_SIZE     (1UL << QPS_MAP_SHIFT)
 #define QPS_MAP_MASK     (QPS_MAP_SIZE - 1)
 
+#define QPS_HUGE_PAGE_SIZE  (2UL << 20)
+
+/* Granularity of the write tracking of the paged maps, in pages, when the
+ * snapshots are taken in process (see qps_set_snapshot_in_process).
+ */
+#define QPS_CHUNK_SHIFT     4UL
+#define QPS_CHUNK_PAGES     (1UL << QPS_CHUNK_SHIFT)
+#define QPS_CHUNK_SIZE      (QPS_CHUNK_PAGES * QPS_PAGE_SIZE)
+#define QPS_MAP_CHUNKS      (QPS_MAP_PAGES >> QPS_CHUNK_SHIFT)
+
     struct {
 #define QPS_META_SIG     "QPS_meta/v01.00"
 #define QPS_MAP_PG_SIG   "QPS_page/v01.00"
@@ -200,12 +213,27 @@ union qps_map_t {
         uint32_t        mapno;
         uint32_t        generation;
         uint32_t        allocated;
-        uint8_t         __padding[QPS_PAGE_SIZE / 2 - 16 - 3 * 4];
+#define QPS_MAP_DELTA    (1U << 0)      /* pages: file is a delta, see .qpb */
+#define QPS_MAP_LZO      (1U << 1)      /* pages: pages compressed with LZO */
+        uint32_t        flags;
+        uint8_t         __padding[QPS_PAGE_SIZE / 2 - 16 - 4 * 4];
 
         /* Past this point, data on disk may be corrupted */
         struct qps_t   *qps;
         uint32_t        remaining;      /* only for memory */
         uint32_t        disk_usage;     /* only for memory */
+
+        /* only for pages: state of the files of the map on disk, and chunks
+         * written since the last full image of the map.
+         */
+#define QPS_MAP_ON_DISK        (1U << 0)  /* files of disk_gen exist */
+#define QPS_MAP_ON_DISK_DELTA  (1U << 1)  /* and they are a delta */
+#define QPS_MAP_TRACKED        (1U << 2)  /* dirty is complete since image */
+        uint32_t        disk_gen;
+        uint16_t        disk_flags;
+        uint16_t        dirty_chunks;
+        qps_snap_map_t *snap;           /* being written in process */
+        uint64_t        dirty[QPS_MAP_CHUNKS / 64];
     } hdr;
     uint8_t data[QPS_PAGE_SIZE];
 };
@@ -219,6 +247,46 @@ struct qps_gcmap_t {
 };
 qvector_t(qps_gcmap, qps_gcmap_t);
 
+/** Progress of the garbage collector, see qps_gc_get_stats(). */
+typedef struct qps_gc_stats_t {
+    uint64_t runs;              /* compactions started */
+    uint64_t slices;            /* steps of the incremental compactions */
+    uint64_t maps_emptied;      /* source maps fully compacted */
+    uint64_t blks_moved;
+    uint64_t bytes_moved;
+    uint64_t slice_usec_total;
+    uint32_t slice_usec_max;
+    bool     running;           /* an incremental compaction is pending */
+} qps_gc_stats_t;
+
+/* Threads that can be in a read section at once, see qps_reader_enter().
+ * A thread keeps its reader slot until it exits, and the process panics
+ * when a thread reads while all the slots are taken.
+ */
+#define QPS_READERS_MAX  256
+
+/* State of the concurrent readers, see qps_readers_enable(). */
+typedef struct qps_reader_slot_t {
+    atomic_uint64_t epoch;      /* 0 outside of a read section */
+    uint32_t        depth;
+} __attribute__((aligned(CACHE_LINE_SIZE))) qps_reader_slot_t;
+
+typedef struct qps_retired_t {
+    uint64_t     epoch;
+    qps_pg_t     pg;            /* retired pages, or the block below */
+    qps_handle_t handle;        /* handle released with the block if any */
+    void        *ptr;
+    qps_map_t   *map;           /* or an emptied map to give back */
+} qps_retired_t;
+qvector_t(qps_retired, qps_retired_t);
+
+typedef struct qps_epoch_t {
+    atomic_uint64_t    global;
+    qps_reader_slot_t *slots;   /* QPS_READERS_MAX, see qps_reader_id_g */
+    qv_t(qps_retired)  retired;
+    int                reclaim_at;
+} qps_epoch_t;
+
 #ifdef __has_blocks
 typedef void (BLOCK_CARET qps_notify_b)(uint32_t gen);
 #else
@@ -250,6 +318,9 @@ typedef struct qps_t {
     /* Allocator state, private */
     qps_pghdr_t *hdrs;
     qps_map_t   *gc_map;     /* do not use, filled for the SIGBUS handler */
+    qps_gc_t    *gc;         /* incremental compaction in progress */
+    qps_gc_stats_t gc_stats;
+    qps_epoch_t *epoch;      /* concurrent readers, NULL if not enabled */
     thr_syn_t   *snapshot_syn; /* not owned by the qps_t */
     el_t         snap_el;
     el_t         snap_timer_el;
@@ -258,6 +329,10 @@ typedef struct qps_t {
     struct timeval snap_start;
     uint32_t     snap_gen;
     uint32_t     snap_max_duration; /* in seconds, 3600 by default */
+    bool         snap_in_process;
+    uint8_t      snap_writers;
+    bool         snap_lzo;
+    qv_t(qps_snap_map) snap_maps;
 
     struct {
 #define QPS_PGL2_SHIFT       5U
@@ -293,6 +368,13 @@ struct qps_stats {
     size_t n_pages_free;
     int pages;
     int pages_free;
+
+    /* Only computed when huge pages are enabled (see qps_set_huge_pages):
+     * number of resident pages of QPS_PAGE_SIZE bytes in the maps, and
+     * number of huge pages of QPS_HUGE_PAGE_SIZE bytes among them.
+     */
+    size_t n_resident_pages;
+    size_t n_huge_pages;
 };
 
 qps_t    *qps_create(const char *path, const char *name, mode_t mode,
@@ -309,6 +391,19 @@ int       qps_unlink(const char *path);
 void      qps_close(qps_t **qps);
 void      qps_get_usage(const qps_t *qps, struct qps_stats *);
 
+/** Back the in-memory maps created from now on with transparent huge pages.
+ *
+ * This reduces the TLB misses of random accesses in large stores. The
+ * huge page coverage is then reported by qps_get_usage(), which becomes
+ * more expensive as it reads /proc/self/smaps.
+ *
+ * Not to split the huge pages, the free runs of pages are only given back to
+ * the system by whole huge pages, and the writes between the snapshots taken
+ * in process are tracked by huge page instead of by chunk: the deltas of the
+ * paged maps then hold whole huge pages, and are less often used.
+ */
+void      qps_set_huge_pages(bool enable);
+
 #ifdef __has_blocks
 uint32_t  qps_snapshot(qps_t *qps, const void *data, size_t dlen,
                        void (BLOCK_CARET notify)(uint32_t gen));
@@ -330,6 +425,48 @@ uint32_t  qps_snapshot(qps_t *qps, const void *data, size_t dlen,
  */
 void qps_set_snapshot_syn(qps_t *qps, thr_syn_t *syn);
 
+/** Take the snapshots from a thread of the process instead of a fork.
+ *
+ * Forking a large store stalls the process while its page tables are
+ * copied. In process, the writes into the paged maps are tracked by chunks
+ * of #QPS_CHUNK_PAGES pages, and a chunk is copied aside when it is written
+ * while the snapshot still has to save it.
+ *
+ * The paged maps with few written chunks since their last full image are
+ * then saved as a delta of this image, that only holds the written pages.
+ *
+ * This function shall not be called during a snapshot.
+ */
+void qps_set_snapshot_in_process(qps_t *qps, bool enable);
+
+#define QPS_SNAPSHOT_WRITERS_MAX  64
+
+/** Set the number of threads writing the maps of the snapshots.
+ *
+ * The maps are spread across the writers, each of them syncing the files it
+ * writes, and the snapshot is committed once they are all written. One
+ * writer (the default) is enough for a rotational disk, several of them are
+ * needed to use the bandwidth of a NVMe device.
+ *
+ * The writers are threads created for each snapshot, in the forked
+ * snapshotter as well as in process (see \ref qps_set_snapshot_in_process),
+ * that never hold the thread jobs.
+ *
+ * This function shall not be called during a snapshot.
+ */
+void qps_set_snapshot_writers(qps_t *qps, int writers);
+
+/** Write the paged maps of the snapshots with LZO instead of gzip.
+ *
+ * The pages are compressed one by one and indexed, the zero pages are not
+ * stored. Writing and loading the maps is much faster, at the cost of larger
+ * files. Both formats are loaded whatever this setting, but the maps written
+ * with LZO cannot be loaded by the versions that predate it.
+ *
+ * This function shall not be called during a snapshot.
+ */
+void qps_set_snapshot_lzo(qps_t *qps, bool enable);
+
 /** Backup a qps.
  * This function shall not be called during a snapshot.
  *
@@ -344,16 +481,40 @@ void qps_set_snapshot_syn(qps_t *qps, thr_syn_t *syn);
  */
 int qps_backup(qps_t *qps, int dfd_dst, bool link_as_copy);
 
-/* TODO Document what the QPS handle garbage collector actually does and how.
- */
 /** Run the QPS handle garbage collector.
+ *
+ * The GC picks the read-only TLSF maps with the most waste, and moves their
+ * live blocks into a new map, so that they are released by the next
+ * snapshot.
  *
  * Can only be run from main thread otherwise the call will have no effect.
+ * It completes the compaction started by qps_gc_start() if any.
  *
  * \warning it's invalid to run the GC while a snapshot is going on!
  */
 void qps_gc_run(qps_t *qps);
 
+#define QPS_GC_SLICE_SIZE  (256UL << 10)
+
+/** Start an incremental run of the QPS handle garbage collector.
+ *
+ * The compaction of qps_gc_run() is split into slices of at most
+ * #QPS_GC_SLICE_SIZE bytes moved, run from an idle callback of the event
+ * loop, so that it does not stall the loop. The handles are consistent
+ * between two slices, only the qps_hptr_t caches must be refreshed, which
+ * qps_hptr_deref() does.
+ *
+ * A snapshot stops the compaction where it stands, the next run of the GC
+ * takes it back from there.
+ *
+ * Can only be run from main thread otherwise the call will have no effect,
+ * and does nothing when a compaction or a snapshot is in progress.
+ */
+void qps_gc_start(qps_t *qps);
+
+/** Get the progress counters of the garbage collector. */
+void qps_gc_get_stats(const qps_t *qps, qps_gc_stats_t *stats);
+
 void qps_snapshot_wait(qps_t *qps);
 
 /* }}} */
@@ -520,6 +681,144 @@ void qps_hptr_free(qps_t *qps, qps_hptr_t *cache)
     p_clear(cache, 1);
 }
 
+/* }}} */
+/* qps: concurrent readers {{{ */
+
+/** Allow other threads to read the qps.
+ *
+ * The qps keeps a single writer, but once enabled, other threads can read
+ * it between qps_reader_enter() and qps_reader_leave() while the writer
+ * modifies it.
+ *
+ * This is an epoch-based reclamation: the memory released by the writer
+ * (unmapped pages, freed blocks, and the blocks moved by qps_realloc() or
+ * qps_pg_remap(), which always move them) is retired with the current epoch
+ * instead of being reused, and is only released once every read section
+ * that may have seen it is left, see qps_reclaim().
+ *
+ * The readers only get a memory-safe view of the qps: what they read may be
+ * being written, the structures built on top of the qps must detect it, see
+ * qhat_reader_get() for example.
+ *
+ * Must be called by the writer before any reader starts, and stays enabled
+ * until qps_close(). qps_pg_unload() must not be used while readers run.
+ */
+void qps_readers_enable(qps_t *qps);
+
+/** Release the memory retired by the writer that no reader can still see.
+ *
+ * The writer does it automatically once enough memory was retired.
+ */
+void qps_reclaim(qps_t *qps);
+
+/** Wait for the read sections in progress, and release all the retired
+ * memory.
+ *
+ * It is done by qps_snapshot(), the GC and qps_close(), so that the retired
+ * memory is not persisted. Must not be called from a read section.
+ */
+void qps_synchronize(qps_t *qps);
+
+/* Reader slot of the calling thread, UINT32_MAX until it first reads. */
+extern __thread uint32_t qps_reader_id_g;
+
+/* Gives a reader slot to the calling thread, panics if the
+ * #QPS_READERS_MAX slots are all taken. */
+uint32_t qps_reader_register(void) __leaf;
+
+/** Enter a read section of the qps.
+ *
+ * Nothing read from the qps in the section is released before the section
+ * is left. The sections can be nested, and must be short as the writer
+ * sometimes waits for them.
+ *
+ * Any thread can read: it gets a reader slot on its first read section, and
+ * gives it back when it exits. The process panics if more than
+ * #QPS_READERS_MAX threads read at once.
+ */
+static ALWAYS_INLINE void qps_reader_enter(qps_t *qps)
+{
+    qps_epoch_t       *epoch = qps->epoch;
+    uint32_t           id    = qps_reader_id_g;
+    qps_reader_slot_t *slot;
+
+    assert (epoch);
+    if (unlikely(id == UINT32_MAX)) {
+        id = qps_reader_register();
+    }
+    slot = &epoch->slots[id];
+    if (slot->depth++ == 0) {
+        atomic_store_explicit(&slot->epoch,
+                              atomic_load_explicit(&epoch->global,
+                                                   memory_order_relaxed),
+                              memory_order_relaxed);
+        /* the epoch must be visible before anything is read */
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+}
+
+static ALWAYS_INLINE void qps_reader_leave(qps_t *qps)
+{
+    qps_reader_slot_t *slot = &qps->epoch->slots[qps_reader_id_g];
+
+    assert (slot->depth > 0);
+    if (--slot->depth == 0) {
+        atomic_store_explicit(&slot->epoch, 0, memory_order_release);
+    }
+}
+
+/** Dereference \p n pages from a read section.
+ *
+ * Unlike qps_pg_deref(), \p pg may have been read in a state being written,
+ * it is checked: NULL is returned if the pages do not lie in a map.
+ */
+static ALWAYS_INLINE
+const void *qps_pg_reader_deref(const qps_t *qps, qps_pg_t pg, size_t n)
+{
+    uint32_t   pos = pg & 0xffff;
+    qps_map_t *map;
+
+    if (pos == 0 || pos + n > QPS_MAP_PAGES) {
+        return NULL;
+    }
+    map = atomic_load_explicit(cast(_Atomic(qps_map_t *) *,
+                                    &qps->maps.tab[pg >> 16]),
+                               memory_order_acquire);
+    return map ? map[pos].data : NULL;
+}
+
+/** Dereference a handle from a read section.
+ *
+ * The block is read from the handle atomically, so that it is consistent
+ * with its moves by the GC. NULL is returned if the handle does not point to
+ * a mapped block.
+ */
+static ALWAYS_INLINE
+const void *qps_handle_reader_deref(const qps_t *qps, qps_handle_t id)
+{
+    const qps_ptr_t *slots;
+    const uint8_t   *data;
+    union {
+        qps_ptr_t ptr;
+        uint64_t  u64;
+    } slot;
+
+    slots = atomic_load_explicit(cast(_Atomic(qps_ptr_t *) *,
+                                      &qps->handles[id / QPS_HANDLES_COUNT]),
+                                 memory_order_acquire);
+    if (!slots) {
+        return NULL;
+    }
+    slot.u64 = atomic_load_explicit(cast(atomic_uint64_t *,
+                                         &slots[id % QPS_HANDLES_COUNT]),
+                                    memory_order_acquire);
+    if (slot.ptr.addr >= QPS_PAGE_SIZE) {
+        return NULL;
+    }
+    data = qps_pg_reader_deref(qps, slot.ptr.pgno, 1);
+    return data ? data + slot.ptr.addr : NULL;
+}
+
 /* }}} */
 
 /** \brief Initialize the QPS module.
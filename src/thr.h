@@ -27,6 +27,7 @@
 #include "core/thr-job.h"
 #include "core/thr-spsc.h"
 #include "core/thr-mpsc.h"
+#include "core/thr-mpmc.h"
 
 extern struct thr_hooks {
     dlist_t init_cbs;
@@ -16,6 +16,7 @@
 /*                                                                         */
 /***************************************************************************/
 
+#include <lib-common/thr.h>
 #include <lib-common/z.h>
 
 /*{{{1 Memory Pool Macros */
@@ -175,6 +176,138 @@ Z_GROUP_EXPORT(fifo)
     } Z_TEST_END
 } Z_GROUP_END
 
+/*1}}}*/
+/*{{{1 Slab Pool */
+
+typedef struct z_slab_free_ctx_t {
+    mem_pool_t *pool;
+    void      **blocks;
+    int         nb_blocks;
+} z_slab_free_ctx_t;
+
+static void *z_slab_free_thr(void *arg)
+{
+    z_slab_free_ctx_t *ctx = arg;
+
+    for (int i = 0; i < ctx->nb_blocks; i++) {
+        mp_delete(ctx->pool, &ctx->blocks[i]);
+    }
+    return NULL;
+}
+
+Z_GROUP_EXPORT(slab)
+{
+    Z_TEST(slab_pool, "slab_pool: allocations of every size class") {
+        mem_pool_t *pool = mem_slab_pool_new("slab.slab_pool");
+        char vtest[8192];
+        char *v[256];
+
+        Z_ASSERT(pool);
+        p_clear(&vtest, 1);
+
+        for (int size = 1; size <= 8192; size += 37) {
+            for (int i = 0; i < countof(v); i++) {
+                v[i] = mp_new(pool, char, size);
+                Z_ASSERT_ZERO(memcmp(v[i], vtest, size), "size %d", size);
+                memset(v[i], 0xaa, size);
+            }
+            for (int i = 0; i < countof(v); i++) {
+                mp_delete(pool, &v[i]);
+            }
+        }
+
+        v[0] = mpa_new(pool, char, 100, 64);
+        Z_ASSERT_ZERO((uintptr_t)v[0] & 63);
+        memset(v[0], 'a', 100);
+        v[0] = mp_irealloc(pool, v[0], 100, 5000, 64, 0);
+        Z_ASSERT_ZERO((uintptr_t)v[0] & 63);
+        Z_ASSERT_EQ(v[0][99], 'a');
+        Z_ASSERT_ZERO(memcmp(v[0] + 100, vtest, 4900));
+        mp_delete(pool, &v[0]);
+
+        mem_slab_pool_delete(&pool);
+        Z_ASSERT_NULL(pool);
+    } Z_TEST_END
+
+    Z_TEST(slab_cross_thread, "slab_pool: free from another thread") {
+        mem_pool_t *pool = mem_slab_pool_new("slab.slab_cross_thread");
+        z_slab_free_ctx_t ctx = {
+            .pool      = pool,
+            .nb_blocks = 10000,
+        };
+        ssize_t allocated = 0;
+        ssize_t used = 0;
+        pthread_t thr;
+
+        ctx.blocks = p_new(void *, ctx.nb_blocks);
+        for (int i = 0; i < ctx.nb_blocks; i++) {
+            ctx.blocks[i] = mp_new(pool, char, 64);
+        }
+        mem_slab_pool_stats(pool, &allocated, &used);
+        if (mem_pool_is_enabled()) {
+            Z_ASSERT_GE(used, 64 * ctx.nb_blocks);
+            Z_ASSERT_GE(allocated, used);
+        }
+
+        Z_ASSERT_ZERO(pthread_create(&thr, NULL, &z_slab_free_thr, &ctx));
+        Z_ASSERT_ZERO(pthread_join(thr, NULL));
+
+        /* The blocks freed by the other thread are reused. */
+        for (int i = 0; i < ctx.nb_blocks; i++) {
+            ctx.blocks[i] = mp_new(pool, char, 64);
+        }
+        if (mem_pool_is_enabled()) {
+            ssize_t allocated2 = 0;
+
+            mem_slab_pool_stats(pool, &allocated2, &used);
+            Z_ASSERT_EQ(allocated2, allocated);
+            Z_ASSERT_EQ(used, 64 * ctx.nb_blocks);
+        }
+        for (int i = 0; i < ctx.nb_blocks; i++) {
+            mp_delete(pool, &ctx.blocks[i]);
+        }
+
+        p_delete(&ctx.blocks);
+        mem_slab_pool_delete(&pool);
+    } Z_TEST_END
+} Z_GROUP_END
+
+/*1}}}*/
+/*{{{1 Allocation profiler */
+
+Z_GROUP_EXPORT(mem_prof)
+{
+    Z_TEST(sampling, "mem_prof: in-use and allocated profiles") {
+        SB_1k(out);
+        void *blocks[64];
+
+        mem_prof_start(1);
+        for (int i = 0; i < countof(blocks); i++) {
+            blocks[i] = p_new_raw(char, 100);
+        }
+        mem_prof_dump_collapsed(&out, true);
+        Z_ASSERT(out.len > 0);
+
+        for (int i = 0; i < countof(blocks); i++) {
+            p_delete(&blocks[i]);
+        }
+        mem_prof_stop();
+
+        sb_reset(&out);
+        mem_prof_dump_collapsed(&out, true);
+        Z_ASSERT_EQ(out.len, 0);
+        mem_prof_dump_collapsed(&out, false);
+        Z_ASSERT(out.len > 0);
+
+        sb_reset(&out);
+        mem_prof_dump_pprof(&out);
+        Z_ASSERT(lstr_startswith(LSTR_SB_V(&out), LSTR("heap profile: ")));
+        Z_ASSERT_P(strstr(out.data, "MAPPED_LIBRARIES:"));
+
+        sb_wipe(&out);
+    } Z_TEST_END
+} Z_GROUP_END
+
 /*1}}}*/
 /*{{{1 Memstack */
 
@@ -211,6 +344,40 @@ Z_GROUP_EXPORT(core_mem_stack) {
 /*}}}1*/
 /*{{{1 Memring */
 
+typedef struct z_ring_mt_ctx_t {
+    mem_pool_t *pool;
+    byte      **blocks;
+    int         nb_blocks;
+    int         id;
+} z_ring_mt_ctx_t;
+
+static int z_ring_mt_size(int i)
+{
+    return 1 + (i * 37) % 300;
+}
+
+static void *z_ring_mt_thr(void *arg)
+{
+    z_ring_mt_ctx_t *ctx = arg;
+
+    for (int i = 0; i < ctx->nb_blocks; i++) {
+        int size = z_ring_mt_size(i);
+        byte *blk = mp_new_raw(ctx->pool, byte, size / 2 + 1);
+
+        /* Grow it, in place when nothing was allocated after it. */
+        blk = mp_irealloc(ctx->pool, blk, size / 2 + 1, size, 1, MEM_RAW);
+        memset(blk, ctx->id, size);
+        ctx->blocks[i] = blk;
+    }
+    return NULL;
+}
+
+static void *z_ring_mt_release_thr(void *frame)
+{
+    mem_ring_release(frame);
+    return NULL;
+}
+
 Z_GROUP_EXPORT(core_mem_ring) {
     Z_TEST(big_alloc_mean, "non regression on #39120") {
         mem_pool_t *rp = mem_ring_new("core_mem_ring.big_alloc_mean", 0);
@@ -224,6 +391,215 @@ Z_GROUP_EXPORT(core_mem_ring) {
         mem_ring_release(rframe);
         mem_ring_delete(&rp);
     } Z_TEST_END
+
+    Z_TEST(multi_producer, "concurrent allocations in a mem_ring_new_mt") {
+        mem_pool_t *rp = mem_ring_new_mt("core_mem_ring.multi_producer",
+                                         PAGE_SIZE);
+        const void *rframe = mem_ring_newframe(rp);
+        z_ring_mt_ctx_t ctx[4];
+        pthread_t thr[countof(ctx)];
+
+        for (int i = 0; i < countof(ctx); i++) {
+            ctx[i] = (z_ring_mt_ctx_t){
+                .pool      = rp,
+                .nb_blocks = 20000,
+                .id        = i + 1,
+            };
+            ctx[i].blocks = p_new(byte *, ctx[i].nb_blocks);
+            Z_ASSERT_ZERO(pthread_create(&thr[i], NULL, &z_ring_mt_thr,
+                                         &ctx[i]));
+        }
+        for (int i = 0; i < countof(ctx); i++) {
+            Z_ASSERT_ZERO(pthread_join(thr[i], NULL));
+        }
+
+        /* The blocks of the threads do not overlap. */
+        for (int i = 0; i < countof(ctx); i++) {
+            for (int j = 0; j < ctx[i].nb_blocks; j++) {
+                byte *blk = ctx[i].blocks[j];
+
+                for (int k = 0; k < z_ring_mt_size(j); k++) {
+                    Z_ASSERT_EQ(blk[k], ctx[i].id, "block %d of thread %d",
+                                j, i);
+                }
+            }
+            p_delete(&ctx[i].blocks);
+        }
+
+        /* The frame is sealed and released from another thread. */
+        mem_ring_seal(rp);
+        Z_ASSERT_ZERO(pthread_create(&thr[0], NULL, &z_ring_mt_release_thr,
+                                     (void *)rframe));
+        Z_ASSERT_ZERO(pthread_join(thr[0], NULL));
+        mem_ring_delete(&rp);
+    } Z_TEST_END
+} Z_GROUP_END
+
+/*}}}1*/
+/*{{{1 Pools accounting */
+
+typedef struct z_pool_stats_ctx_t {
+    const char      *name;
+    int              nb;
+    mem_pool_stats_t st;
+} z_pool_stats_ctx_t;
+
+static void z_pool_stats_cb(const mem_pool_stats_t *st, void *priv)
+{
+    z_pool_stats_ctx_t *ctx = priv;
+
+    if (strequal(st->name, ctx->name)) {
+        ctx->nb++;
+        ctx->st = *st;
+        /* The strings are only valid during the call. */
+        ctx->st.owner = st->owner ? "set" : NULL;
+    }
+}
+
+Z_GROUP_EXPORT(mem_pools_accounting)
+{
+    Z_TEST(fifo_ring, "accounting of fifo and ring pools") {
+        z_pool_stats_ctx_t ctx = { .name = "z.accounting.fifo" };
+        mem_pool_t *fifo;
+        mem_pool_t *ring;
+        const void *rframe;
+        void *blk;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("the memory pools are bypassed");
+        }
+        fifo = mem_fifo_pool_new("z.accounting.fifo", 0);
+        ring = mem_ring_new("z.accounting.ring", 0);
+        rframe = mem_ring_newframe(ring);
+
+        mem_pool_set_owner(fifo, "z-owner");
+        mem_pool_set_owner(ring, "z-owner");
+
+        blk = mp_new_raw(fifo, char, 1000);
+        mp_new_raw(ring, char, 1000);
+
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.nb, 1);
+        Z_ASSERT_STREQUAL(ctx.st.type, "fifo");
+        Z_ASSERT_P(ctx.st.owner);
+        Z_ASSERT_GE(ctx.st.used, 1000);
+        Z_ASSERT_GE(ctx.st.allocated, 1000u);
+        Z_ASSERT_GE(ctx.st.reserved, (size_t)ctx.st.used);
+        Z_ASSERT_GE(ctx.st.reserved_hwm, ctx.st.reserved);
+
+        /* The allocated bytes are cumulated, the used ones are not. */
+        mp_delete(fifo, &blk);
+        p_clear(&ctx, 1);
+        ctx.name = "z.accounting.fifo";
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.st.used, 0);
+        Z_ASSERT_GE(ctx.st.allocated, 1000u);
+
+        p_clear(&ctx, 1);
+        ctx.name = "z.accounting.ring";
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.nb, 1);
+        Z_ASSERT_STREQUAL(ctx.st.type, "ring");
+        Z_ASSERT_P(ctx.st.owner);
+        Z_ASSERT_GE(ctx.st.used, 1000);
+        Z_ASSERT_GE(ctx.st.allocated, 1000u);
+        Z_ASSERT_GE(ctx.st.reserved, (size_t)ctx.st.used);
+
+        /* Deleted pools are not reported anymore. */
+        mem_ring_release(rframe);
+        mem_ring_delete(&ring);
+        mem_fifo_pool_delete(&fifo);
+        p_clear(&ctx, 1);
+        ctx.name = "z.accounting.ring";
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_ZERO(ctx.nb);
+    } Z_TEST_END
+
+    Z_TEST(stack, "accounting of stack pools") {
+        z_pool_stats_ctx_t ctx = { .name = "z.accounting.stack" };
+        mem_pool_t *sp;
+        uint64_t allocated;
+        char *blk;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("the memory pools are bypassed");
+        }
+        sp = mem_stack_new("z.accounting.stack", 0);
+        mem_stack_push(sp);
+
+        blk = mp_new_raw(sp, char, 1000);
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.nb, 1);
+        Z_ASSERT_STREQUAL(ctx.st.type, "stack");
+        Z_ASSERT_GE(ctx.st.allocated, 1000u);
+        allocated = ctx.st.allocated;
+
+        /* Shrinking in place does not lower the allocated bytes, growing
+         * in place adds the difference. */
+        blk = mp_irealloc(sp, blk, 1000, 10, 1, MEM_RAW);
+        p_clear(&ctx, 1);
+        ctx.name = "z.accounting.stack";
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.st.allocated, allocated);
+
+        mp_irealloc(sp, blk, 10, 500, 1, MEM_RAW);
+        p_clear(&ctx, 1);
+        ctx.name = "z.accounting.stack";
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.st.allocated, allocated + 490);
+
+        mem_stack_pop(sp);
+        mem_stack_delete(&sp);
+    } Z_TEST_END
+
+    Z_TEST(ring_mt, "accounting of multi-producer ring pools") {
+        z_pool_stats_ctx_t ctx = { .name = "z.accounting.ring_mt" };
+        z_ring_mt_ctx_t thr_ctx[4];
+        pthread_t thr[countof(thr_ctx)];
+        uint64_t min_allocated = 0;
+        uint64_t max_allocated = 0;
+        const void *rframe;
+        mem_pool_t *rp;
+
+        if (!mem_pool_is_enabled()) {
+            Z_SKIP("the memory pools are bypassed");
+        }
+        rp = mem_ring_new_mt("z.accounting.ring_mt", PAGE_SIZE);
+        rframe = mem_ring_newframe(rp);
+
+        for (int i = 0; i < countof(thr_ctx); i++) {
+            thr_ctx[i] = (z_ring_mt_ctx_t){
+                .pool      = rp,
+                .nb_blocks = 2000,
+                .id        = i + 1,
+            };
+            thr_ctx[i].blocks = p_new(byte *, thr_ctx[i].nb_blocks);
+            Z_ASSERT_ZERO(pthread_create(&thr[i], NULL, &z_ring_mt_thr,
+                                         &thr_ctx[i]));
+        }
+        for (int i = 0; i < countof(thr_ctx); i++) {
+            Z_ASSERT_ZERO(pthread_join(thr[i], NULL));
+            p_delete(&thr_ctx[i].blocks);
+        }
+
+        /* The counters of all the threads are folded in the statistics,
+         * each growth being either in place or a new allocation. */
+        for (int i = 0; i < countof(thr_ctx); i++) {
+            for (int j = 0; j < thr_ctx[i].nb_blocks; j++) {
+                int size = z_ring_mt_size(j);
+
+                min_allocated += size;
+                max_allocated += size / 2 + 1 + size;
+            }
+        }
+        mem_pools_get_stats(&z_pool_stats_cb, &ctx);
+        Z_ASSERT_EQ(ctx.nb, 1);
+        Z_ASSERT_GE(ctx.st.allocated, min_allocated);
+        Z_ASSERT_LE(ctx.st.allocated, max_allocated);
+
+        mem_ring_release(rframe);
+        mem_ring_delete(&rp);
+    } Z_TEST_END
 } Z_GROUP_END
 
 /*}}}1*/
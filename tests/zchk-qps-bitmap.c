@@ -16,6 +16,31 @@
 
 /* LCOV_EXCL_START */
 
+/* Rows of the operands of the set operations tests: rows multiple of
+ * \p step in [from, to[, plus a few rows under the last root. In nullable
+ * bitmaps, one of those rows out of two is set to 0 instead of 1. */
+static void z_bitmap_fill(qps_bitmap_t *map, uint32_t step, uint32_t from,
+                          uint32_t to)
+{
+    bool is_nullable = map->root->is_nullable;
+
+    for (uint32_t row = from; row < to; row += step) {
+        if (is_nullable && (row / step) % 2) {
+            qps_bitmap_reset(map, row);
+        } else {
+            qps_bitmap_set(map, row);
+        }
+    }
+    for (uint32_t row = UINT32_MAX - 10 * step; row < UINT32_MAX; row += step) {
+        qps_bitmap_set(map, row);
+    }
+}
+
+static bool z_bitmap_has(qps_bitmap_t *map, uint32_t row)
+{
+    return qps_bitmap_get(map, row) == QPS_BITMAP_1;
+}
+
 Z_GROUP_EXPORT(qps_bitmap) {
     qps_t *qps;
 
@@ -154,6 +179,218 @@ Z_GROUP_EXPORT(qps_bitmap) {
         }
     } Z_TEST_END;
 
+    /* }}} */
+    Z_TEST(get_many, "") { /* {{{ */
+        for (int nullable = 0; nullable <= 1; nullable++) {
+            t_scope;
+            qps_handle_t handle = qps_bitmap_create(qps, nullable);
+            qps_bitmap_t bitmap;
+            uint32_t count = 5003;
+            uint32_t *rows = t_new_raw(uint32_t, count);
+            qps_bitmap_state_t *states = t_new_raw(qps_bitmap_state_t, count);
+
+            qps_bitmap_init(&bitmap, qps, handle);
+            for (uint32_t i = 0; i < 0x30000; i += 3) {
+                if (nullable && i % 2) {
+                    qps_bitmap_reset(&bitmap, i);
+                } else {
+                    qps_bitmap_set(&bitmap, i);
+                }
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                rows[i] = (i % 2) ? rand_range(0, 0x40000) : (uint32_t)rand();
+            }
+
+            qps_bitmap_get_many(&bitmap, rows, count, states);
+            for (uint32_t i = 0; i < count; i++) {
+                Z_ASSERT_EQ(states[i], qps_bitmap_get(&bitmap, rows[i]),
+                            "row %u", rows[i]);
+            }
+            qps_bitmap_destroy(&bitmap);
+        }
+    } Z_TEST_END;
+
+    /* }}} */
+    Z_TEST(set_operations, "") { /* {{{ */
+        for (int nullable = 0; nullable <= 1; nullable++) {
+            qps_bitmap_t other;
+
+            qps_bitmap_init(&other, qps, qps_bitmap_create(qps, nullable));
+            z_bitmap_fill(&other, 5, 0x20000, 0x90000);
+
+            for (int op = 0; op < 3; op++) {
+                qps_bitmap_t map;
+                uint64_t count = 0;
+
+                qps_bitmap_init(&map, qps, qps_bitmap_create(qps, false));
+                z_bitmap_fill(&map, 3, 0, 0x50000);
+                switch (op) {
+                  case 0:
+                    qps_bitmap_and(&map, &other);
+                    break;
+                  case 1:
+                    qps_bitmap_or(&map, &other);
+                    break;
+                  case 2:
+                    qps_bitmap_and_not(&map, &other);
+                    break;
+                }
+
+                for (uint32_t row = 0; row < 0xa0000; row++) {
+                    bool in_map = row < 0x50000 && row % 3 == 0;
+                    bool in_other = z_bitmap_has(&other, row);
+                    bool res;
+
+                    switch (op) {
+                      case 0:
+                        res = in_map && in_other;
+                        break;
+                      case 1:
+                        res = in_map || in_other;
+                        break;
+                      default:
+                        res = in_map && !in_other;
+                        break;
+                    }
+                    Z_ASSERT_EQ(z_bitmap_has(&map, row), res,
+                                "op %d, nullable %d, row %u",
+                                op, nullable, row);
+                    count += res;
+                }
+                for (uint32_t row = UINT32_MAX - 30; row < UINT32_MAX; row++) {
+                    bool in_map = (UINT32_MAX - row) % 3 == 0;
+                    bool in_other = (UINT32_MAX - row) % 5 == 0;
+
+                    if (op == 0) {
+                        Z_ASSERT_EQ(z_bitmap_has(&map, row),
+                                    in_map && in_other);
+                    } else
+                    if (op == 1) {
+                        Z_ASSERT_EQ(z_bitmap_has(&map, row),
+                                    in_map || in_other);
+                    } else {
+                        Z_ASSERT_EQ(z_bitmap_has(&map, row),
+                                    in_map && !in_other);
+                    }
+                }
+                Z_ASSERT_EQ(qps_bitmap_count_range(&map, 0, 0x9ffff), count);
+                qps_bitmap_destroy(&map);
+            }
+            qps_bitmap_destroy(&other);
+        }
+
+        /* the leaves emptied by the operations are released */
+        for (int nullable = 0; nullable <= 1; nullable++) {
+            qps_bitmap_t map, other;
+            size_t memory;
+            uint32_t entries, slots;
+
+            qps_bitmap_init(&map, qps, qps_bitmap_create(qps, false));
+            qps_bitmap_init(&other, qps, qps_bitmap_create(qps, nullable));
+            z_bitmap_fill(&map, 7, 0, 0x50000);
+            z_bitmap_fill(&other, 7, 0, 0x50000);
+            qps_bitmap_and_not(&map, &other);
+            if (!nullable) {
+                qps_bitmap_compute_stats(&map, &memory, &entries, &slots);
+                Z_ASSERT_ZERO(memory);
+                Z_ASSERT_ZERO(entries);
+            }
+            qps_bitmap_destroy(&map);
+            qps_bitmap_destroy(&other);
+        }
+    } Z_TEST_END;
+
+    /* }}} */
+    Z_TEST(count_range, "") { /* {{{ */
+        for (int nullable = 0; nullable <= 1; nullable++) {
+            qps_bitmap_t map;
+
+            qps_bitmap_init(&map, qps, qps_bitmap_create(qps, nullable));
+            z_bitmap_fill(&map, 3, 0x100, 0x30000);
+
+            Z_ASSERT_EQ(qps_bitmap_count_range(&map, 0, UINT32_MAX),
+                        qps_bitmap_count_range(&map, 0, 0x2ffff)
+                      + qps_bitmap_count_range(&map, 0x30000, UINT32_MAX));
+            Z_ASSERT_EQ(qps_bitmap_count_range(&map, 0x30000, UINT32_MAX),
+                        10U);
+            Z_ASSERT_ZERO(qps_bitmap_count_range(&map, 0x200, 0x100));
+
+            for (int i = 0; i < 100; i++) {
+                uint32_t first = rand_range(0, 0x32000);
+                uint32_t last = first + rand_range(0, 0x12000);
+                uint64_t count = 0;
+
+                for (uint32_t row = first; row <= last; row++) {
+                    count += z_bitmap_has(&map, row);
+                }
+                Z_ASSERT_EQ(qps_bitmap_count_range(&map, first, last), count,
+                            "[%u, %u]", first, last);
+            }
+            qps_bitmap_destroy(&map);
+        }
+    } Z_TEST_END;
+
+    /* }}} */
+    Z_TEST(wah, "") { /* {{{ */
+        for (int nullable = 0; nullable <= 1; nullable++) {
+            t_scope;
+            qps_bitmap_t map, copy;
+            wah_t wah;
+            qv_t(u32) rows;
+            uint64_t count;
+            int pos = 0;
+
+            wah_init(&wah);
+            t_qv_init(&rows, 1024);
+            qps_bitmap_init(&map, qps, qps_bitmap_create(qps, nullable));
+            z_bitmap_fill(&map, 3, 0x10, 0x30000);
+            z_bitmap_fill(&map, 0x1001, 0x1000000, 0x2000000);
+            qps_bitmap_for_each_unsafe(en, &map) {
+                if (en.value) {
+                    qv_append(&rows, en.key.key);
+                }
+            }
+            count = rows.len;
+
+            qps_bitmap_to_wah(&map, &wah);
+            wah_for_each_1(en, &wah) {
+                Z_ASSERT_LT(pos, rows.len);
+                Z_ASSERT_EQ(en.key, (uint64_t)rows.tab[pos], "pos %d", pos);
+                pos++;
+            }
+            Z_ASSERT_EQ(pos, rows.len);
+            Z_ASSERT_EQ(wah.len, (uint64_t)*tab_last(&rows) + 1);
+            Z_ASSERT_EQ(wah.active, count);
+
+            /* into a bitmap that already has rows */
+            qps_bitmap_init(&copy, qps, qps_bitmap_create(qps, nullable));
+            qps_bitmap_set(&copy, 0x11);
+            qps_bitmap_reset(&copy, 0x14);
+            qps_bitmap_from_wah(&copy, &wah);
+            Z_ASSERT_EQ(qps_bitmap_count_range(&copy, 0, UINT32_MAX),
+                        count + 1);
+            Z_ASSERT(z_bitmap_has(&copy, 0x11));
+            qps_bitmap_reset(&copy, 0x11);
+            wah_for_each_1(en, &wah) {
+                Z_ASSERT(z_bitmap_has(&copy, en.key), "row %ju", en.key);
+            }
+            if (!nullable) {
+                size_t memory, memory_copy;
+                uint32_t entries, entries_copy, slots;
+
+                qps_bitmap_compute_stats(&map, &memory, &entries, &slots);
+                qps_bitmap_compute_stats(&copy, &memory_copy, &entries_copy,
+                                         &slots);
+                Z_ASSERT_EQ(memory_copy, memory);
+                Z_ASSERT_EQ(entries_copy, entries);
+            }
+
+            qps_bitmap_destroy(&copy);
+            qps_bitmap_destroy(&map);
+            wah_wipe(&wah);
+        }
+    } Z_TEST_END;
+
     /* }}} */
 
     qps_close(&qps);